@@ -26,13 +26,24 @@ public:
 
     void on_initialize() final;
     void on_event(om::event&) final;
+    void on_events(om::event_span events) final;
     void on_update(std::chrono::milliseconds frame_delta) final;
     void on_render() const final;
 
 private:
+    /// objects of level that never move, one mesh per texture
+    struct static_mesh
+    {
+        om::texture* texture = nullptr;
+        om::vbo*     mesh    = nullptr;
+    };
+
+    void bake_static_level();
+
     std::vector<game_object>            objects;
     std::map<std::string, om::vbo*>     meshes;
     std::map<std::string, om::texture*> textures;
+    std::vector<static_mesh>            static_level;
 };
 
 std::unique_ptr<om::lila> om_tat_sat()
@@ -52,6 +63,9 @@ om::vbo* load_mesh_from_file_with_scale(const std::string_view path,
                                         const om::vec2&        scale);
 void     tanks_game::on_initialize()
 {
+    // all res/*.png images are in one page, see tools/atlas_packer.cxx
+    om::load_texture_atlas("res/textures.atlas");
+
     debug_texture = om::create_texture("res/debug.png");
 
     auto level = filter_comments("res/level_01.txt");
@@ -90,6 +104,56 @@ void     tanks_game::on_initialize()
             obj.texture = tex;
         }
     });
+
+    bake_static_level();
+}
+
+void tanks_game::bake_static_level()
+{
+    static const std::vector<object_type> static_order = {
+        object_type::level, object_type::brick_wall
+    };
+
+    std::vector<std::vector<om::vertex>> vertexes;
+    for (object_type type : static_order)
+    {
+        for (const game_object& obj : objects)
+        {
+            if (obj.type != type)
+            {
+                continue;
+            }
+            auto it = std::find_if(begin(static_level), end(static_level),
+                                   [&obj](const static_mesh& m) {
+                                       return m.texture == obj.texture;
+                                   });
+            if (it == end(static_level))
+            {
+                static_level.push_back({ obj.texture, nullptr });
+                vertexes.emplace_back();
+                it = std::prev(end(static_level));
+            }
+            std::vector<om::vertex>& group =
+                vertexes[static_cast<size_t>(it - begin(static_level))];
+
+            assert(obj.mesh->indexes() == nullptr);
+            const om::matrix m = om::matrix::rotation(obj.direction) *
+                                 om::matrix::move(obj.position);
+            std::transform(obj.mesh->data(),
+                           obj.mesh->data() + obj.mesh->size(),
+                           std::back_inserter(group), [&m](om::vertex v) {
+                               v.pos = v.pos * m;
+                               return v;
+                           });
+        }
+    }
+
+    for (size_t i = 0; i < static_level.size(); ++i)
+    {
+        static_level[i].mesh = om::create_vbo(
+            vertexes[i].data(), vertexes[i].size(),
+            om::vbo_usage::static_draw, om::vbo_draw::own_buffer);
+    }
 }
 
 void tanks_game::on_event(om::event& event)
@@ -120,6 +184,14 @@ void tanks_game::on_event(om::event& event)
     }
 }
 
+void tanks_game::on_events(om::event_span events)
+{
+    for (om::event& event : events)
+    {
+        on_event(event); // final, no virtual call per event
+    }
+}
+
 void tanks_game::on_update(std::chrono::milliseconds /*frame_delta*/)
 {
     if (om::is_key_down(om::keys::left))
@@ -156,8 +228,9 @@ void tanks_game::on_render() const
     struct draw
     {
         draw(const object_type type, const om::vec2& world_size,
-             const float height_aspect)
+             const float height_aspect, const bool outline_)
             : obj_type(type)
+            , outline(outline_)
             , world(om::matrix::scale(2 * height_aspect / world_size.x,
                                       2 * height_aspect / world_size.y))
         {
@@ -181,15 +254,19 @@ void tanks_game::on_render() const
                 om::vbo&     vbo     = *obj.mesh;
                 om::texture* texture = obj.texture;
 
-                om::render(om::primitives::triangls, vbo, texture, m);
-                if (debug_texture)
+                if (outline)
                 {
                     om::render(om::primitives::line_loop, vbo, debug_texture,
                                m);
                 }
+                else
+                {
+                    om::render(om::primitives::triangls, vbo, texture, m);
+                }
             }
         }
         const object_type obj_type;
+        const bool        outline;
         const om::matrix  world;
     };
 
@@ -197,6 +274,9 @@ void tanks_game::on_render() const
         object_type::level, object_type::brick_wall, object_type::ai_tank,
         object_type::user_tank
     };
+    static const std::vector<object_type> moving_order = {
+        object_type::ai_tank, object_type::user_tank
+    };
 
     auto it =
         std::find_if(begin(objects), end(objects), [](const game_object& obj) {
@@ -211,11 +291,33 @@ void tanks_game::on_render() const
     const om::vec2 world_size = it->size;
     const float    aspect = static_cast<float>(screen_height) / screen_width;
 
-    std::for_each(begin(render_order), end(render_order),
+    // static level is already in GPU memory, it is drawn with one call
+    // per texture and nothing is uploaded for it
+    const om::matrix world_aspect =
+        om::matrix::scale(2 * aspect / world_size.x,
+                          2 * aspect / world_size.y) *
+        om::matrix::scale(1, static_cast<float>(screen_width) / screen_height);
+    for (const static_mesh& level_part : static_level)
+    {
+        om::render(om::primitives::triangls, *level_part.mesh,
+                   level_part.texture, world_aspect);
+    }
+
+    std::for_each(begin(moving_order), end(moving_order),
                   [&](object_type type) {
                       std::for_each(begin(objects), end(objects),
-                                    draw(type, world_size, aspect));
+                                    draw(type, world_size, aspect, false));
                   });
+    // outlines after all objects, so they are one batch with one texture
+    // and do not break batches of objects
+    if (debug_texture)
+    {
+        std::for_each(begin(render_order), end(render_order),
+                      [&](object_type type) {
+                          std::for_each(begin(objects), end(objects),
+                                        draw(type, world_size, aspect, true));
+                      });
+    }
 
     // use default ImGui Demo example
     bool show_demo_window = true;
@@ -225,6 +327,15 @@ void tanks_game::on_render() const
     bool editor_is_opened = true;
     ImGui::Begin("Level Map Editor", &editor_is_opened);
     ImGui::Text("Hello!");
+    const om::render_stats stats = om::get_render_stats();
+    ImGui::Text("draw calls: %u vertexes: %u render calls: %u",
+                static_cast<unsigned>(stats.draw_calls),
+                static_cast<unsigned>(stats.vertexes),
+                static_cast<unsigned>(stats.render_calls));
+    ImGui::Text("uploaded to GPU: %u bytes",
+                static_cast<unsigned>(stats.upload_bytes));
+    ImGui::Text("elided GL calls: %u",
+                static_cast<unsigned>(stats.elided_gl_calls));
     ImGui::End();
 }
 
@@ -12,13 +12,17 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string_view>
 #include <thread>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "picopng.hxx"
@@ -53,6 +57,7 @@ PFNGLVERTEXATTRIBPOINTERPROC      glVertexAttribPointer      = nullptr;
 PFNGLENABLEVERTEXATTRIBARRAYPROC  glEnableVertexAttribArray  = nullptr;
 PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray = nullptr;
 PFNGLGETUNIFORMLOCATIONPROC       glGetUniformLocation       = nullptr;
+PFNGLGETACTIVEUNIFORMPROC         glGetActiveUniform         = nullptr;
 PFNGLUNIFORM1IPROC                glUniform1i                = nullptr;
 PFNGLACTIVETEXTUREPROC            glActiveTexture            = nullptr;
 PFNGLUNIFORM4FVPROC               glUniform4fv               = nullptr;
@@ -60,6 +65,7 @@ PFNGLUNIFORMMATRIX3FVPROC         glUniformMatrix3fv         = nullptr;
 PFNGLUNIFORMMATRIX4FVPROC         glUniformMatrix4fv         = nullptr;
 PFNGLBINDBUFFERPROC               glBindBuffer               = nullptr;
 PFNGLBUFFERDATAPROC               glBufferData               = nullptr;
+PFNGLBUFFERSUBDATAPROC            glBufferSubData            = nullptr;
 PFNGLGENBUFFERSPROC               glGenBuffers               = nullptr;
 PFNGLGETATTRIBLOCATIONPROC        glGetAttribLocation        = nullptr;
 PFNGLBLENDFUNCSEPARATEPROC        glBlendFuncSeparate        = nullptr;
@@ -201,19 +207,40 @@ vbo::~vbo() {}
 class vertex_buffer_impl final : public vbo
 {
 public:
-    vertex_buffer_impl(const vertex* tri, std::size_t n)
-        : vertexes(n)
-    {
-        assert(tri != nullptr);
-        std::copy_n(tri, n, begin(vertexes));
-    }
+    vertex_buffer_impl(const vertex* tri, std::size_t n,
+                       const std::uint16_t* indexes_, std::size_t index_n,
+                       vbo_usage usage_, vbo_draw draw_);
     ~vertex_buffer_impl() final;
 
     const vertex*  data() const final { return vertexes.data(); }
     virtual size_t size() const final { return vertexes.size(); }
+    const std::uint16_t* indexes() const final
+    {
+        return index_data.empty() ? nullptr : index_data.data();
+    }
+    size_t    index_count() const final { return index_data.size(); }
+    vbo_usage usage() const final { return usage_hint; }
+    vbo_draw  draw_path() const final { return draw_hint; }
+    void      update(const vertex* tri, std::size_t n,
+                     const std::uint16_t* indexes_, std::size_t index_n) final;
+
+    /// bind GPU buffers for drawing, mesh is uploaded here on first draw
+    /// after update(), batched mesh never gets GPU buffers
+    void bind() const;
 
 private:
-    std::vector<vertex> vertexes;
+    void upload(GLenum target, GLuint& buffer, std::size_t& capacity,
+                const void* bytes, std::size_t size) const;
+
+    std::vector<vertex>        vertexes;
+    std::vector<std::uint16_t> index_data;
+    vbo_usage                  usage_hint;
+    vbo_draw                   draw_hint;
+    mutable GLuint             vertex_buffer   = 0;
+    mutable GLuint             index_buffer    = 0;
+    mutable std::size_t        vertex_capacity = 0; // bytes in GPU buffer
+    mutable std::size_t        index_capacity  = 0;
+    mutable bool               is_uploaded     = false;
 };
 
 static std::string_view get_sound_format_name(uint16_t format_value)
@@ -265,8 +292,144 @@ std::vector<sound_buffer_impl*> sounds;
 
 bool developer_mode = true;
 bool reload_game    = false;
+
+// frame profiler: every thread writes zone durations to its own rings
+// without locks, mutex is taken only for new thread and to read stats
+enum class zone : std::uint8_t
+{
+    events,
+    update,
+    render,
+    swap,
+    reload,
+    count
+};
+
+constexpr std::array<const char*, static_cast<size_t>(zone::count)>
+    zone_names{ { "events", "update", "render", "swap", "reload" } };
+
+constexpr size_t zone_window = 300; // samples of zone in stats
+
+// ring per zone, so rare zone like reload keeps its history while
+// frequent ones wrap every few seconds
+struct zone_ring
+{
+    // duration in nanoseconds
+    std::array<std::atomic<std::int64_t>, zone_window> samples{};
+    std::atomic<std::uint64_t>                         head{ 0 };
+};
+
+using thread_zone_rings =
+    std::array<zone_ring, static_cast<size_t>(zone::count)>;
+
+std::mutex                                      zone_rings_mutex;
+std::vector<std::unique_ptr<thread_zone_rings>> zone_rings; // outlive threads
 // no more Globals ////////////////////////////////////////////////////////////
 
+static void record_zone(zone z, std::chrono::nanoseconds duration)
+{
+    thread_local thread_zone_rings* rings = nullptr;
+    if (rings == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(zone_rings_mutex);
+        zone_rings.push_back(std::make_unique<thread_zone_rings>());
+        rings = zone_rings.back().get();
+    }
+    zone_ring&          ring = (*rings)[static_cast<size_t>(z)];
+    const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.samples[head % zone_window].store(
+        std::max<std::int64_t>(duration.count(), 0),
+        std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+class scoped_zone
+{
+public:
+    explicit scoped_zone(zone z_)
+        : start(std::chrono::steady_clock::now())
+        , z(z_)
+    {
+    }
+    ~scoped_zone()
+    {
+        record_zone(z, std::chrono::steady_clock::now() - start);
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    zone                                  z;
+};
+
+std::vector<zone_stats> get_frame_stats()
+{
+    std::array<std::vector<std::int64_t>, static_cast<size_t>(zone::count)>
+        durations;
+    {
+        std::lock_guard<std::mutex> lock(zone_rings_mutex);
+        for (const auto& rings : zone_rings)
+        {
+            for (size_t index = 0; index < durations.size(); ++index)
+            {
+                const zone_ring&    ring = (*rings)[index];
+                const std::uint64_t head =
+                    ring.head.load(std::memory_order_acquire);
+                const std::uint64_t count =
+                    std::min<std::uint64_t>(head, zone_window);
+                for (std::uint64_t i = 1; i <= count; ++i) // newest first
+                {
+                    if (durations[index].size() == zone_window)
+                    {
+                        break;
+                    }
+                    durations[index].push_back(
+                        ring.samples[(head - i) % zone_window].load(
+                            std::memory_order_relaxed));
+                }
+            }
+        }
+    }
+
+    std::vector<zone_stats> result;
+    for (size_t index = 0; index < durations.size(); ++index)
+    {
+        std::vector<std::int64_t>& sorted = durations[index];
+        if (sorted.empty())
+        {
+            continue;
+        }
+        std::sort(begin(sorted), end(sorted));
+        // nearest rank
+        auto percentile = [&sorted](double part) {
+            const auto rank = static_cast<size_t>(
+                std::ceil(part * static_cast<double>(sorted.size())));
+            return std::chrono::nanoseconds(
+                sorted[std::max<size_t>(rank, 1) - 1]);
+        };
+        zone_stats stats;
+        stats.name    = zone_names[index];
+        stats.p50     = percentile(0.50);
+        stats.p95     = percentile(0.95);
+        stats.p99     = percentile(0.99);
+        stats.max     = std::chrono::nanoseconds(sorted.back());
+        stats.samples = sorted.size();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+static void dump_frame_stats()
+{
+    using ms = std::chrono::duration<double, std::milli>;
+    for (const zone_stats& stats : get_frame_stats())
+    {
+        log << stats.name << ": p50 " << ms(stats.p50).count() << " p95 "
+            << ms(stats.p95).count() << " p99 " << ms(stats.p99).count()
+            << " max " << ms(stats.max).count() << " ms (" << stats.samples
+            << " frames)" << std::endl;
+    }
+}
+
 class sound_buffer_impl final : public sound
 {
 public:
@@ -390,31 +553,191 @@ sound_buffer_impl::~sound_buffer_impl()
     length = 0;
 }
 
-vertex_buffer_impl::~vertex_buffer_impl() {}
+/// Last GL state set by engine, calls which would not change it are
+/// skipped and counted. ImGui changes state behind engine, so cache is
+/// invalidated after it draws.
+class gl_state_cache
+{
+public:
+    void use_program(GLuint program)
+    {
+        if (program == current_program)
+        {
+            ++elided;
+            return;
+        }
+        glUseProgram(program);
+        OM_GL_CHECK();
+        current_program = program;
+    }
+
+    void bind_texture(size_t unit, GLuint texture)
+    {
+        assert(unit < textures.size());
+        if (textures[unit] == texture)
+        {
+            ++elided;
+            return;
+        }
+        if (active_unit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit));
+            OM_GL_CHECK();
+            active_unit = unit;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        OM_GL_CHECK();
+        textures[unit] = texture;
+    }
+
+    void bind_buffer(GLenum target, GLuint buffer)
+    {
+        GLuint& current =
+            target == GL_ARRAY_BUFFER ? array_buffer : element_buffer;
+        if (current == buffer)
+        {
+            ++elided;
+            return;
+        }
+        glBindBuffer(target, buffer);
+        OM_GL_CHECK();
+        current = buffer;
+    }
+
+    /// attributes of om::vertex from buffer, the only layout of engine
+    void set_vertex_buffer(GLuint buffer)
+    {
+        bind_buffer(GL_ARRAY_BUFFER, buffer);
+        if (layout_buffer == buffer)
+        {
+            elided += 3; // pointers still point into this buffer
+        }
+        else
+        {
+            // positions
+            glVertexAttribPointer(
+                0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex),
+                reinterpret_cast<const void*>(offsetof(vertex, pos)));
+            OM_GL_CHECK();
+            // colors
+            glVertexAttribPointer(
+                1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex),
+                reinterpret_cast<const void*>(offsetof(vertex, c)));
+            OM_GL_CHECK();
+            // texture coordinates
+            glVertexAttribPointer(
+                2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex),
+                reinterpret_cast<const void*>(offsetof(vertex, uv)));
+            OM_GL_CHECK();
+            layout_buffer = buffer;
+        }
+        for (GLuint index = 0; index < 3; ++index)
+        {
+            enable_attribute(index);
+        }
+    }
+
+    /// GL unbinds deleted objects itself
+    void forget_texture(GLuint texture)
+    {
+        std::replace(begin(textures), end(textures), texture, GLuint{ 0 });
+    }
+    void forget_buffer(GLuint buffer)
+    {
+        for (GLuint* current : { &array_buffer, &element_buffer })
+        {
+            if (*current == buffer)
+            {
+                *current = 0;
+            }
+        }
+        if (layout_buffer == buffer)
+        {
+            layout_buffer = unknown;
+        }
+    }
+
+    void invalidate()
+    {
+        const size_t count = elided;
+        *this              = gl_state_cache();
+        elided             = count;
+    }
+
+    /// call skipped outside of cache, cached uniform for example
+    void count_elided() { ++elided; }
+    /// skipped calls since previous call
+    size_t take_elided() { return std::exchange(elided, 0); }
+
+private:
+    static constexpr GLuint unknown = std::numeric_limits<GLuint>::max();
+
+    void enable_attribute(GLuint index)
+    {
+        const std::uint32_t bit = 1u << index;
+        if (enabled_attributes & bit)
+        {
+            ++elided;
+            return;
+        }
+        glEnableVertexAttribArray(index);
+        OM_GL_CHECK();
+        enabled_attributes |= bit;
+    }
+
+    GLuint                current_program = unknown;
+    size_t                active_unit     = unknown;
+    std::array<GLuint, 8> textures{
+        { unknown, unknown, unknown, unknown, unknown, unknown, unknown,
+          unknown }
+    };
+    GLuint        array_buffer       = unknown;
+    GLuint        element_buffer     = unknown;
+    GLuint        layout_buffer      = unknown;
+    std::uint32_t enabled_attributes = 0; // known to be enabled
+    size_t        elided             = 0;
+};
+
+static gl_state_cache gl_state;
+
+/// part of texture in texture coordinates: uv = origin + uv * size
+struct uv_rect
+{
+    vec2 origin{ 0.f, 0.f };
+    vec2 size{ 1.f, 1.f };
+};
 
 class texture_gl_es20 final : public texture
 {
 public:
     explicit texture_gl_es20(std::string_view path);
+    /// image packed into atlas page, page owns GL texture, rect in pixels
+    /// from top left corner like in atlas file
+    texture_gl_es20(const texture_gl_es20& page, std::string_view name,
+                    std::uint32_t x, std::uint32_t y, std::uint32_t width_,
+                    std::uint32_t height_);
     ~texture_gl_es20() override;
 
-    void bind() const
+    void bind(size_t unit) const
     {
-        GLboolean is_texture = glIsTexture(tex_handl);
-        assert(is_texture);
-        OM_GL_CHECK();
-        glBindTexture(GL_TEXTURE_2D, tex_handl);
-        OM_GL_CHECK();
+        assert(glIsTexture(tex_handl));
+        gl_state.bind_texture(unit, tex_handl);
     }
 
     std::uint32_t get_width() const final { return width; }
     std::uint32_t get_height() const final { return height; }
 
+    /// images of one atlas page have the same handle
+    GLuint         get_handle() const { return tex_handl; }
+    const uv_rect& get_uv_rect() const { return uv; }
+
 private:
     std::string   file_path;
     GLuint        tex_handl = 0;
     std::uint32_t width     = 0;
     std::uint32_t height    = 0;
+    uv_rect       uv;
+    bool          is_owner = true;
 };
 
 class shader_gl_es20
@@ -435,70 +758,63 @@ public:
         {
             throw std::runtime_error("can't link shader");
         }
+        find_uniforms();
     }
 
-    void use() const
-    {
-        glUseProgram(program_id);
-        OM_GL_CHECK();
-    }
+    void use() const { gl_state.use_program(program_id); }
 
+    /// program has to be in use for all set_uniform()
     void set_uniform(std::string_view       uniform_name,
                      const texture_gl_es20* texture)
     {
         assert(texture != nullptr);
-        const int location =
-            glGetUniformLocation(program_id, uniform_name.data());
-        OM_GL_CHECK();
-        if (location == -1)
-        {
-            std::cerr << "can't get uniform location from shader\n";
-            throw std::runtime_error("can't get uniform location");
-        }
-        unsigned int texture_unit = 0;
-        glActiveTexture(GL_TEXTURE0 + texture_unit);
-        OM_GL_CHECK();
+        uniform&     u            = get_uniform(uniform_name);
+        const size_t texture_unit = 0;
 
-        texture->bind();
+        texture->bind(texture_unit);
 
         // http://www.khronos.org/opengles/sdk/docs/man/xhtml/glUniform.xml
-        glUniform1i(location, static_cast<int>(0 + texture_unit));
-        OM_GL_CHECK();
+        if (u.change({ static_cast<float>(texture_unit) }))
+        {
+            glUniform1i(u.location, static_cast<int>(texture_unit));
+            OM_GL_CHECK();
+        }
     }
 
     void set_uniform(std::string_view uniform_name, const color& c)
     {
-        const int location =
-            glGetUniformLocation(program_id, uniform_name.data());
-        OM_GL_CHECK();
-        if (location == -1)
+        uniform& u = get_uniform(uniform_name);
+        if (u.change({ c.get_r(), c.get_g(), c.get_b(), c.get_a() }))
         {
-            std::cerr << "can't get uniform location from shader\n";
-            throw std::runtime_error("can't get uniform location");
+            glUniform4fv(u.location, 1, u.value.data());
+            OM_GL_CHECK();
         }
-        float values[4] = { c.get_r(), c.get_g(), c.get_b(), c.get_a() };
-        glUniform4fv(location, 1, &values[0]);
-        OM_GL_CHECK();
     }
 
-    void set_uniform(std::string_view uniform_name, const matrix& m)
+    void set_uniform(std::string_view uniform_name, const uv_rect& rect)
     {
-        const int location =
-            glGetUniformLocation(program_id, uniform_name.data());
-        OM_GL_CHECK();
-        if (location == -1)
+        uniform& u = get_uniform(uniform_name);
+        if (u.change({ rect.origin.x, rect.origin.y, rect.size.x,
+                       rect.size.y }))
         {
-            std::cerr << "can't get uniform location from shader\n";
-            throw std::runtime_error("can't get uniform location");
+            glUniform4fv(u.location, 1, u.value.data());
+            OM_GL_CHECK();
         }
+    }
+
+    void set_uniform(std::string_view uniform_name, const matrix& m)
+    {
+        uniform& u = get_uniform(uniform_name);
         // OpenGL wants matrix in column major order
         // clang-format off
-        float values[9] = { m.row0.x,  m.row0.y, m.row2.x,
-                            m.row1.x, m.row1.y, m.row2.y,
-                            0.f,      0.f,       1.f };
+        if (u.change({ m.row0.x,  m.row0.y, m.row2.x,
+                       m.row1.x, m.row1.y, m.row2.y,
+                       0.f,      0.f,       1.f }))
         // clang-format on
-        glUniformMatrix3fv(location, 1, GL_FALSE, &values[0]);
-        OM_GL_CHECK();
+        {
+            glUniformMatrix3fv(u.location, 1, GL_FALSE, u.value.data());
+            OM_GL_CHECK();
+        }
     }
 
 private:
@@ -585,9 +901,75 @@ private:
         return program_id_;
     }
 
-    GLuint vert_shader = 0;
-    GLuint frag_shader = 0;
-    GLuint program_id  = 0;
+    /// uniform keeps its value in program, so last value is cached here
+    struct uniform
+    {
+        /// false if uniform already has these values
+        bool change(std::initializer_list<float> values)
+        {
+            assert(values.size() <= value.size());
+            if (is_set && std::equal(values.begin(), values.end(),
+                                     value.begin()))
+            {
+                gl_state.count_elided();
+                return false;
+            }
+            std::copy(values.begin(), values.end(), value.begin());
+            is_set = true;
+            return true;
+        }
+
+        std::string          name;
+        GLint                location = -1;
+        std::array<float, 9> value{};
+        bool                 is_set = false;
+    };
+
+    /// all locations once after link, no glGetUniformLocation per draw
+    void find_uniforms()
+    {
+        GLint count      = 0;
+        GLint max_length = 0;
+        glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &count);
+        OM_GL_CHECK();
+        glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+        OM_GL_CHECK();
+        std::vector<GLchar> name(static_cast<size_t>(max_length) + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint   size   = 0;
+            GLenum  type   = 0;
+            glGetActiveUniform(program_id, static_cast<GLuint>(i),
+                               static_cast<GLsizei>(name.size()), &length,
+                               &size, &type, name.data());
+            OM_GL_CHECK();
+            uniform u;
+            u.name     = std::string(name.data(), static_cast<size_t>(length));
+            u.location = glGetUniformLocation(program_id, u.name.c_str());
+            OM_GL_CHECK();
+            uniforms.push_back(u);
+        }
+    }
+
+    uniform& get_uniform(std::string_view uniform_name)
+    {
+        auto it = std::find_if(begin(uniforms), end(uniforms),
+                               [&](const uniform& u) {
+                                   return u.name == uniform_name;
+                               });
+        if (it == end(uniforms) || it->location == -1)
+        {
+            std::cerr << "can't get uniform location from shader\n";
+            throw std::runtime_error("can't get uniform location");
+        }
+        return *it;
+    }
+
+    GLuint               vert_shader = 0;
+    GLuint               frag_shader = 0;
+    GLuint               program_id  = 0;
+    std::vector<uniform> uniforms;
 };
 
 std::ostream& operator<<(std::ostream& stream, const input_data& i)
@@ -694,21 +1076,115 @@ const std::array<bind, 8> keys{
       bind{ "start", SDLK_RETURN, keys::start } }
 };
 
-static bool check_input(const SDL_Event& e, const bind*& result)
+// SDL keycode is unicode character or scancode with SDLK_SCANCODE_MASK,
+// characters below 256 and scancodes fit into one small table, so key
+// lookup is one load instead of search
+constexpr size_t      keycode_table_size = 256 + SDL_NUM_SCANCODES;
+constexpr std::int8_t no_binding         = -1;
+
+/// keycode_table_size for key that can't be bound, like 'ő'
+static size_t get_keycode_index(SDL_Keycode code)
 {
-    using namespace std;
+    if (code & SDLK_SCANCODE_MASK)
+    {
+        const auto scancode = static_cast<size_t>(code & ~SDLK_SCANCODE_MASK);
+        return scancode < SDL_NUM_SCANCODES ? 256 + scancode
+                                            : keycode_table_size;
+    }
+    return code >= 0 && code < 256 ? static_cast<size_t>(code)
+                                   : keycode_table_size;
+}
+
+// keycode index -> index in keys
+static const std::array<std::int8_t, keycode_table_size> keycode_bindings =
+    [] {
+        std::array<std::int8_t, keycode_table_size> result;
+        result.fill(no_binding);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const size_t index = get_keycode_index(keys[i].key);
+            assert(index < keycode_table_size);
+            result[index] = static_cast<std::int8_t>(i);
+        }
+        return result;
+    }();
 
-    const auto it = find_if(begin(keys), end(keys), [&](const bind& b) {
-        return b.key == e.key.keysym.sym;
-    });
+// om::keys -> index in keys
+static const std::array<std::int8_t, keys.size()> key_bindings = [] {
+    std::array<std::int8_t, keys.size()> result;
+    result.fill(no_binding);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        result[static_cast<size_t>(keys[i].om_key)] =
+            static_cast<std::int8_t>(i);
+    }
+    return result;
+}();
 
-    if (it != end(keys))
+/// Lock-free queue of one producer and one consumer thread. Producer
+/// never waits: when queue is full new items are dropped and counted.
+template <typename T, size_t capacity>
+class spsc_ring
+{
+    static_assert((capacity & (capacity - 1)) == 0,
+                  "capacity has to be power of two");
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "items are copied as bytes");
+
+public:
+    /// producer thread
+    bool push(const T& item)
     {
-        result = &(*it);
+        const size_t write = tail.load(std::memory_order_relaxed);
+        if (write - head_cache == capacity)
+        {
+            head_cache = head.load(std::memory_order_acquire);
+            if (write - head_cache == capacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        items[write & (capacity - 1)] = item;
+        tail.store(write + 1, std::memory_order_release);
         return true;
     }
-    return false;
-}
+
+    /// consumer thread: appends all items to out, at most two copies
+    size_t pop_all(std::vector<T>& out)
+    {
+        const size_t read  = head.load(std::memory_order_relaxed);
+        const size_t count = tail.load(std::memory_order_acquire) - read;
+        const size_t first = read & (capacity - 1);
+        const size_t part  = std::min(count, capacity - first);
+        out.insert(out.end(), items.begin() + first,
+                   items.begin() + first + part);
+        out.insert(out.end(), items.begin(), items.begin() + (count - part));
+        head.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    /// any thread
+    size_t get_dropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    // producer and consumer write to different cache lines
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    size_t              head_cache = 0; // last head seen by producer
+    std::atomic<size_t> dropped{ 0 };
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::array<T, capacity> items{};
+};
+
+// Producer is SDL event pump, it may be moved to input thread (SDL event
+// watch on android) without changes on game side
+static spsc_ring<event, 256> input_ring;
+static std::vector<event>    frame_events; // given to game this frame
+static size_t                next_frame_event = 0; // for pool_event
+static size_t                logged_dropped   = 0; // dropped input events
 
 membuf load_file(std::string_view path)
 {
@@ -748,73 +1224,524 @@ float get_time_from_init()
     float         seconds = ms_from_library_initialization * 0.001f;
     return seconds;
 }
+/// SDL event to engine event in input ring, ImGui sees every SDL event
+static void translate_event(SDL_Event& sdl_event)
+{
+    ImGui_ImplSdlGL3_ProcessEvent(&sdl_event);
+
+    const double timestamp = sdl_event.common.timestamp * 0.001;
+    if (sdl_event.type == SDL_QUIT)
+    {
+        input_ring.push(
+            event{ hardware_data{ true }, timestamp, event_type::hardware });
+    }
+    else if (sdl_event.type == SDL_KEYDOWN || sdl_event.type == SDL_KEYUP)
+    {
+        const SDL_Keycode code = sdl_event.key.keysym.sym;
+        if (developer_mode && code == SDLK_BACKSPACE &&
+            sdl_event.type == SDL_KEYUP)
+        {
+            reload_game = true;
+        }
+
+        const size_t index = get_keycode_index(code);
+        if (index < keycode_bindings.size() &&
+            keycode_bindings[index] != no_binding)
+        {
+            const bool is_down = sdl_event.type == SDL_KEYDOWN;
+            const bind& binding =
+                keys[static_cast<size_t>(keycode_bindings[index])];
+            input_ring.push(event{ input_data{ binding.om_key, is_down },
+                                   timestamp,
+                                   event_type::input_key });
+        }
+    }
+}
+
+event_span poll_events()
+{
+    frame_events.clear();
+    next_frame_event = 0;
+
+    SDL_PumpEvents();
+    std::array<SDL_Event, 64> batch;
+    int                       count = 0;
+    do
+    {
+        count = SDL_PeepEvents(batch.data(), static_cast<int>(batch.size()),
+                               SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+        for (int i = 0; i < count; ++i)
+        {
+            translate_event(batch[static_cast<size_t>(i)]);
+        }
+        // drained after every batch, storm bigger than ring is not lost
+        input_ring.pop_all(frame_events);
+    } while (count == static_cast<int>(batch.size()));
+
+    const size_t dropped = input_ring.get_dropped();
+    if (dropped != logged_dropped)
+    {
+        log << "input ring is full, dropped events: "
+            << dropped - logged_dropped << std::endl;
+        logged_dropped = dropped;
+    }
+
+    return event_span{ frame_events.data(), frame_events.size() };
+}
+
 /// pool event from input queue
 /// return true if more events in queue
 bool pool_event(event& e)
 {
-    using namespace std;
-    // collect all events from SDL
-    SDL_Event sdl_event;
-    if (SDL_PollEvent(&sdl_event))
+    if (next_frame_event == frame_events.size())
+    {
+        poll_events();
+    }
+    if (next_frame_event == frame_events.size())
+    {
+        return false;
+    }
+    e = frame_events[next_frame_event++];
+    return true;
+}
+
+bool is_key_down(const enum keys key)
+{
+    const std::int8_t binding = key_bindings[static_cast<size_t>(key)];
+    if (binding == no_binding)
     {
-        /*bool used_with_imgui = */ ImGui_ImplSdlGL3_ProcessEvent(&sdl_event);
+        return false;
+    }
+    const std::uint8_t* state = SDL_GetKeyboardState(nullptr);
+    const SDL_Scancode  code =
+        SDL_GetScancodeFromKey(keys[static_cast<size_t>(binding)].key);
+    return state[code];
+}
+
+static const std::array<GLenum, 6> primitive_types = {
+    { GL_LINES, GL_LINE_STRIP, GL_LINE_LOOP, GL_TRIANGLES, GL_TRIANGLE_STRIP,
+      GL_TRIANGLE_FAN }
+};
 
-        const bind* binding = nullptr;
+/// Vertexes of render() calls transformed on CPU and collected in one
+/// array while texture, shader and kind of primitive stay the same. Strips,
+/// fans and loops are unrolled into triangle and line lists, so any mix of
+/// them is drawn with one glDrawArrays. Order of calls is kept, blending
+/// gives the same picture as drawing every mesh alone. Batches go to GPU
+/// through one stream buffer used as ring.
+class sprite_batch
+{
+public:
+    sprite_batch() { vertexes.reserve(max_vertexes); }
 
-        if (sdl_event.type == SDL_QUIT)
+    void add(const enum primitives primitive_type, const vbo& buff,
+             const texture_gl_es20* tex, const matrix& m)
+    {
+        const vertex*        v       = buff.data();
+        const std::uint16_t* indexes = buff.indexes();
+        const size_t n = indexes ? buff.index_count() : buff.size();
+
+        // images of one atlas page are one texture for batch
+        const GLenum mode = is_lines(primitive_type) ? GL_LINES : GL_TRIANGLES;
+        if (!vertexes.empty() &&
+            (tex->get_handle() != texture->get_handle() ||
+             shader03 != shader || mode != draw_mode ||
+             vertexes.size() + 3 * n > max_vertexes))
         {
-            e.info      = om::hardware_data{ true };
-            e.timestamp = sdl_event.common.timestamp * 0.001;
-            e.type      = om::event_type::hardware;
-            return true;
+            flush();
         }
-        else if (sdl_event.type == SDL_KEYDOWN || sdl_event.type == SDL_KEYUP)
+        texture   = tex;
+        shader    = shader03;
+        draw_mode = mode;
+        ++frame.render_calls;
+
+        const uv_rect& uv         = tex->get_uv_rect();
+        auto           add_vertex = [&](size_t i) {
+            vertex result = v[indexes ? indexes[i] : i];
+            result.pos    = result.pos * m;
+            result.uv     = vec2(uv.origin.x + result.uv.x * uv.size.x,
+                             uv.origin.y + result.uv.y * uv.size.y);
+            vertexes.push_back(result);
+        };
+
+        switch (primitive_type)
         {
-            if (developer_mode && sdl_event.key.keysym.sym == SDLK_BACKSPACE &&
-                sdl_event.type == SDL_KEYUP)
-            {
-                reload_game = true;
-            }
+            case primitives::triangls:
+                for (size_t i = 0; i + 2 < n; i += 3)
+                {
+                    add_vertex(i);
+                    add_vertex(i + 1);
+                    add_vertex(i + 2);
+                }
+                break;
+            case primitives::trianglestrip:
+                for (size_t i = 2; i < n; ++i)
+                {
+                    // every odd triangle has reversed order in strip
+                    add_vertex(i % 2 == 0 ? i - 2 : i - 1);
+                    add_vertex(i % 2 == 0 ? i - 1 : i - 2);
+                    add_vertex(i);
+                }
+                break;
+            case primitives::trianglfan:
+                for (size_t i = 2; i < n; ++i)
+                {
+                    add_vertex(0);
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                }
+                break;
+            case primitives::lines:
+                for (size_t i = 0; i + 1 < n; i += 2)
+                {
+                    add_vertex(i);
+                    add_vertex(i + 1);
+                }
+                break;
+            case primitives::line_strip:
+            case primitives::line_loop:
+                for (size_t i = 1; i < n; ++i)
+                {
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                }
+                if (primitive_type == primitives::line_loop && n > 1)
+                {
+                    add_vertex(n - 1);
+                    add_vertex(0);
+                }
+                break;
+        }
+    }
 
-            if (check_input(sdl_event, binding))
-            {
-                bool is_down = sdl_event.type == SDL_KEYDOWN;
-                e.info       = om::input_data{ binding->om_key, is_down };
-                e.timestamp  = sdl_event.common.timestamp * 0.001;
-                e.type       = om::event_type::input_key;
-                return true;
-            }
+    void flush()
+    {
+        if (vertexes.empty())
+        {
+            return;
+        }
+        shader->use();
+        shader->set_uniform("s_texture", texture);
+        shader->set_uniform("u_matrix", matrix::identity());
+        shader->set_uniform("u_uv_rect", uv_rect()); // done on CPU
+
+        const size_t bytes = vertexes.size() * sizeof(vertex);
+        if (stream_buffer == 0)
+        {
+            glGenBuffers(1, &stream_buffer);
+            OM_GL_CHECK();
+            stream_offset = stream_capacity;
+        }
+        gl_state.set_vertex_buffer(stream_buffer);
+        // ring: every batch is written after previous one, when ring is
+        // full buffer is orphaned - driver gives new memory and frees old
+        // one after GPU draws from it, so CPU never waits for GPU
+        if (stream_offset + vertexes.size() > stream_capacity)
+        {
+            glBufferData(GL_ARRAY_BUFFER,
+                         static_cast<GLsizeiptr>(stream_capacity *
+                                                 sizeof(vertex)),
+                         nullptr, GL_STREAM_DRAW);
+            OM_GL_CHECK();
+            stream_offset = 0;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        static_cast<GLintptr>(stream_offset * sizeof(vertex)),
+                        static_cast<GLsizeiptr>(bytes), vertexes.data());
+        OM_GL_CHECK();
+        frame.upload_bytes += bytes;
+
+        glDrawArrays(draw_mode, static_cast<GLint>(stream_offset),
+                     static_cast<GLsizei>(vertexes.size()));
+        OM_GL_CHECK();
+
+        stream_offset += vertexes.size();
+        count_draw(vertexes.size());
+        vertexes.clear();
+    }
+
+    /// mesh from its own GPU buffers, batch has to be flushed before
+    void draw(const enum primitives primitive_type,
+              const vertex_buffer_impl& buff, const texture_gl_es20* tex,
+              const matrix& m)
+    {
+        assert(vertexes.empty());
+        ++frame.render_calls;
+        shader03->use();
+        shader03->set_uniform("s_texture", tex);
+        shader03->set_uniform("u_matrix", m);
+        shader03->set_uniform("u_uv_rect", tex->get_uv_rect());
+
+        buff.bind();
+        const GLenum mode =
+            primitive_types[static_cast<uint32_t>(primitive_type)];
+        if (buff.indexes() != nullptr)
+        {
+            glDrawElements(mode, static_cast<GLsizei>(buff.index_count()),
+                           GL_UNSIGNED_SHORT, nullptr);
+            OM_GL_CHECK();
+            count_draw(buff.index_count());
+        }
+        else
+        {
+            glDrawArrays(mode, 0, static_cast<GLsizei>(buff.size()));
+            OM_GL_CHECK();
+            count_draw(buff.size());
+        }
+    }
+
+    void count_upload(size_t bytes) { frame.upload_bytes += bytes; }
+
+    /// texture is going to be destroyed
+    void forget(const texture* tex)
+    {
+        if (tex == texture)
+        {
+            flush();
+            texture = nullptr;
+        }
+    }
+
+    /// call after last flush of frame
+    void end_frame()
+    {
+        frame.elided_gl_calls = gl_state.take_elided();
+        last_frame            = frame;
+        frame      = render_stats{};
+    }
+
+    render_stats get_last_frame_stats() const { return last_frame; }
+
+    /// before GL context is destroyed
+    void release()
+    {
+        if (stream_buffer != 0)
+        {
+            glDeleteBuffers(1, &stream_buffer);
+            OM_GL_CHECK();
+            gl_state.forget_buffer(stream_buffer);
+            stream_buffer = 0;
+        }
+    }
+
+private:
+    static constexpr size_t max_vertexes    = 16 * 1024;
+    static constexpr size_t stream_capacity = 4 * max_vertexes;
+
+    void count_draw(size_t vertex_count)
+    {
+        ++frame.draw_calls;
+        frame.vertexes += vertex_count;
+    }
+
+    static bool is_lines(const enum primitives primitive_type)
+    {
+        return primitive_type == primitives::lines ||
+            primitive_type == primitives::line_strip ||
+            primitive_type == primitives::line_loop;
+    }
+
+    std::vector<vertex>    vertexes;
+    const texture_gl_es20* texture   = nullptr;
+    shader_gl_es20*        shader    = nullptr;
+    GLenum                 draw_mode = GL_TRIANGLES;
+    render_stats           frame;
+    render_stats           last_frame;
+    GLuint                 stream_buffer = 0;
+    size_t                 stream_offset = 0; // in vertexes
+};
+
+static sprite_batch batch;
+
+vertex_buffer_impl::vertex_buffer_impl(const vertex* tri, std::size_t n,
+                                       const std::uint16_t* indexes_,
+                                       std::size_t index_n, vbo_usage usage_,
+                                       vbo_draw draw_)
+    : usage_hint(usage_)
+    , draw_hint(draw_)
+{
+    update(tri, n, indexes_, index_n);
+}
+
+vertex_buffer_impl::~vertex_buffer_impl()
+{
+    if (vertex_buffer != 0)
+    {
+        glDeleteBuffers(1, &vertex_buffer);
+        OM_GL_CHECK();
+        gl_state.forget_buffer(vertex_buffer);
+    }
+    if (index_buffer != 0)
+    {
+        glDeleteBuffers(1, &index_buffer);
+        OM_GL_CHECK();
+        gl_state.forget_buffer(index_buffer);
+    }
+}
+
+void vertex_buffer_impl::update(const vertex* tri, std::size_t n,
+                                const std::uint16_t* indexes_,
+                                std::size_t          index_n)
+{
+    assert(tri != nullptr);
+    assert(index_n == 0 || indexes_ != nullptr);
+    assert(std::all_of(indexes_, indexes_ + index_n,
+                       [n](std::uint16_t i) { return i < n; }));
+    vertexes.assign(tri, tri + n);
+    index_data.assign(indexes_, indexes_ + index_n);
+    is_uploaded = false;
+}
+
+void vertex_buffer_impl::bind() const
+{
+    if (!is_uploaded)
+    {
+        upload(GL_ARRAY_BUFFER, vertex_buffer, vertex_capacity,
+               vertexes.data(), vertexes.size() * sizeof(vertex));
+        if (!index_data.empty() || index_buffer != 0)
+        {
+            upload(GL_ELEMENT_ARRAY_BUFFER, index_buffer, index_capacity,
+                   index_data.data(),
+                   index_data.size() * sizeof(std::uint16_t));
         }
+        is_uploaded = true;
+    }
+    gl_state.set_vertex_buffer(vertex_buffer);
+    if (index_buffer != 0)
+    {
+        gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
     }
-    return false;
 }
 
-bool is_key_down(const enum keys key)
+void vertex_buffer_impl::upload(GLenum target, GLuint& buffer,
+                                std::size_t& capacity, const void* bytes,
+                                std::size_t size) const
+{
+    static const std::array<GLenum, 3> gl_usages = {
+        { GL_STATIC_DRAW, GL_DYNAMIC_DRAW, GL_STREAM_DRAW }
+    };
+    const GLenum gl_usage = gl_usages[static_cast<size_t>(usage_hint)];
+
+    if (buffer == 0)
+    {
+        glGenBuffers(1, &buffer);
+        OM_GL_CHECK();
+    }
+    gl_state.bind_buffer(target, buffer);
+    if (usage_hint == vbo_usage::static_draw || size > capacity)
+    {
+        glBufferData(target, static_cast<GLsizeiptr>(size), bytes, gl_usage);
+        OM_GL_CHECK();
+        capacity = size;
+    }
+    else
+    {
+        // orphaning: old memory is freed by driver after draws in flight,
+        // write to new memory does not wait for GPU
+        glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr,
+                     gl_usage);
+        OM_GL_CHECK();
+        glBufferSubData(target, 0, static_cast<GLsizeiptr>(size), bytes);
+        OM_GL_CHECK();
+    }
+    batch.count_upload(size);
+}
+
+struct atlas_image
 {
-    const auto it = std::find_if(
-        begin(keys), end(keys), [&](const bind& b) { return b.om_key == key; });
+    const texture_gl_es20* page   = nullptr;
+    std::uint32_t          x      = 0;
+    std::uint32_t          y      = 0;
+    std::uint32_t          width  = 0;
+    std::uint32_t          height = 0;
+};
+
+// pages by path, loaded once, live till engine is uninitialized
+static std::map<std::string, std::unique_ptr<texture_gl_es20>> atlas_pages;
+static std::map<std::string, atlas_image, std::less<>>          atlas_images;
 
-    if (it != end(keys))
+void load_texture_atlas(std::string_view path)
+{
+    membuf       buf = load_file(path);
+    std::istream in(&buf);
+
+    auto expect = [&](std::string_view key_word) {
+        std::string word;
+        in >> word;
+        if (word != key_word)
+        {
+            throw std::runtime_error("can't parse texture atlas " +
+                                     std::string(path) + " expected: " +
+                                     std::string(key_word) + " got: " + word);
+        }
+    };
+
+    size_t num_of_pages = 0;
+    expect("num_of_pages");
+    in >> num_of_pages;
+    std::vector<const texture_gl_es20*> pages;
+    for (size_t i = 0; i < num_of_pages; ++i)
     {
-        const std::uint8_t* state         = SDL_GetKeyboardState(nullptr);
-        int                 sdl_scan_code = SDL_GetScancodeFromKey(it->key);
-        return state[sdl_scan_code];
+        std::string page_path;
+        expect("page");
+        in >> page_path;
+        std::unique_ptr<texture_gl_es20>& page = atlas_pages[page_path];
+        if (!page)
+        {
+            page = std::make_unique<texture_gl_es20>(page_path);
+        }
+        pages.push_back(page.get());
+    }
+
+    size_t num_of_images = 0;
+    expect("num_of_images");
+    in >> num_of_images;
+    for (size_t i = 0; i < num_of_images; ++i)
+    {
+        std::string name;
+        size_t      page_index = 0;
+        atlas_image img;
+        in >> name >> page_index >> img.x >> img.y >> img.width >> img.height;
+        if (!in || page_index >= pages.size() ||
+            img.x + img.width > pages[page_index]->get_width() ||
+            img.y + img.height > pages[page_index]->get_height())
+        {
+            throw std::runtime_error("bad image in texture atlas " +
+                                     std::string(path) + ": " + name);
+        }
+        img.page           = pages[page_index];
+        atlas_images[name] = img;
     }
-    return false;
 }
 
 texture* create_texture(std::string_view path)
 {
+    auto it = atlas_images.find(path);
+    if (it != end(atlas_images))
+    {
+        const atlas_image& img = it->second;
+        return new texture_gl_es20(*img.page, path, img.x, img.y, img.width,
+                                   img.height);
+    }
     return new texture_gl_es20(path);
 }
 void destroy_texture(texture* t)
 {
+    batch.forget(t);
     delete t;
 }
 
-vbo* create_vbo(const vertex* vertexes, std::size_t n)
+vbo* create_vbo(const vertex* vertexes, std::size_t n, vbo_usage usage,
+                vbo_draw draw)
+{
+    return new vertex_buffer_impl(vertexes, n, nullptr, 0, usage, draw);
+}
+vbo* create_vbo(const vertex* vertexes, std::size_t n,
+                const std::uint16_t* indexes, std::size_t num_of_indexes,
+                vbo_usage usage, vbo_draw draw)
 {
-    return new vertex_buffer_impl(vertexes, n);
+    return new vertex_buffer_impl(vertexes, n, indexes, num_of_indexes, usage,
+                                  draw);
 }
 void destroy_vbo(vbo* buffer)
 {
@@ -835,48 +1762,29 @@ void destroy_sound(sound* sound)
     delete sound;
 }
 
-static const std::array<GLenum, 6> primitive_types = {
-    { GL_LINES, GL_LINE_STRIP, GL_LINE_LOOP, GL_TRIANGLES, GL_TRIANGLE_STRIP,
-      GL_TRIANGLE_FAN }
-};
-
 void render(const enum primitives primitive_type, const vbo& buff,
             const texture* tex, const matrix& m)
 {
-    shader03->use();
-    const texture_gl_es20* texture = static_cast<const texture_gl_es20*>(tex);
-    texture->bind();
-    shader03->set_uniform("s_texture", texture);
-    shader03->set_uniform("u_matrix", m);
+    // copy of few vertexes is cheaper than separate draw call, big mesh
+    // and own_buffer one are drawn from GPU memory and cost no upload
+    constexpr size_t max_batched_vertexes = 64;
 
-    const vertex* t = buff.data();
-    // positions
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), &t->pos);
-    OM_GL_CHECK();
-    glEnableVertexAttribArray(0);
-    OM_GL_CHECK();
-    // colors
-    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex),
-                          &t->c);
-    OM_GL_CHECK();
-    glEnableVertexAttribArray(1);
-    OM_GL_CHECK();
-
-    // texture coordinates
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), &t->uv);
-    OM_GL_CHECK();
-    glEnableVertexAttribArray(2);
-    OM_GL_CHECK();
-
-    GLsizei num_of_vertexes = static_cast<GLsizei>(buff.size());
-    GLenum  priv_type = primitive_types[static_cast<uint32_t>(primitive_type)];
-    glDrawArrays(priv_type, 0, num_of_vertexes);
-    OM_GL_CHECK();
+    const auto* texture = static_cast<const texture_gl_es20*>(tex);
+    const size_t count = buff.indexes() ? buff.index_count() : buff.size();
+    if (buff.draw_path() == vbo_draw::batch_small &&
+        count <= max_batched_vertexes)
+    {
+        batch.add(primitive_type, buff, texture, m);
+        return;
+    }
+    batch.flush(); // keep order of draws
+    batch.draw(primitive_type, static_cast<const vertex_buffer_impl&>(buff),
+               texture, m);
+}
 
-    glDisableVertexAttribArray(1);
-    OM_GL_CHECK();
-    glDisableVertexAttribArray(2);
-    OM_GL_CHECK();
+render_stats get_render_stats()
+{
+    return batch.get_last_frame_stats();
 }
 
 static void swap_buffers()
@@ -889,6 +1797,7 @@ static void swap_buffers()
 
 void exit(int return_code)
 {
+    dump_frame_stats();
     std::exit(return_code);
 }
 
@@ -1039,6 +1948,7 @@ static void initialize_internal(std::string_view   title,
             load_gl_func("glDisableVertexAttribArray",
                          glDisableVertexAttribArray);
             load_gl_func("glGetUniformLocation", glGetUniformLocation);
+            load_gl_func("glGetActiveUniform", glGetActiveUniform);
             load_gl_func("glUniform1i", glUniform1i);
             load_gl_func("glActiveTexture", glActiveTexture);
             load_gl_func("glUniform4fv", glUniform4fv);
@@ -1046,6 +1956,7 @@ static void initialize_internal(std::string_view   title,
             load_gl_func("glUniformMatrix4fv", glUniformMatrix4fv);
             load_gl_func("glBindBuffer", glBindBuffer);
             load_gl_func("glBufferData", glBufferData);
+            load_gl_func("glBufferSubData", glBufferSubData);
             load_gl_func("glGenBuffers", glGenBuffers);
             load_gl_func("glGetAttribLocation", glGetAttribLocation);
             load_gl_func("glBlendFuncSeparate", glBlendFuncSeparate);
@@ -1172,6 +2083,7 @@ static void initialize_internal(std::string_view   title,
 				    precision highp float;
 				    #endif //GL_ES
                     uniform mat3 u_matrix;
+                    uniform vec4 u_uv_rect;
                     attribute vec2 a_position;
                     attribute vec2 a_tex_coord;
                     attribute vec4 a_color;
@@ -1179,7 +2091,7 @@ static void initialize_internal(std::string_view   title,
                     varying vec2 v_tex_coord;
                     void main()
                     {
-                    v_tex_coord = a_tex_coord;
+                    v_tex_coord = u_uv_rect.xy + a_tex_coord * u_uv_rect.zw;
                     v_color = a_color;
                     vec3 pos = vec3(a_position, 1.0) * u_matrix;
                     gl_Position = vec4(pos, 1.0);
@@ -1296,6 +2208,9 @@ static void uninitialize()
     {
         // TODO uninitialize ImGui
         ImGui_ImplSdlGL3_Shutdown();
+        batch.release();
+        atlas_images.clear();
+        atlas_pages.clear();
 
         SDL_GL_DeleteContext(gl_context);
         SDL_DestroyWindow(window);
@@ -1387,15 +2302,16 @@ texture_gl_es20::texture_gl_es20(std::string_view path)
 
     glGenTextures(1, &tex_handl);
     OM_GL_CHECK();
-    glBindTexture(GL_TEXTURE_2D, tex_handl);
-    OM_GL_CHECK();
+    gl_state.bind_texture(0, tex_handl);
 
-    GLint   mipmap_level = 0;
-    GLint   border       = 0;
-    GLsizei width        = static_cast<GLsizei>(img.width);
-    GLsizei height       = static_cast<GLsizei>(img.height);
-    glTexImage2D(GL_TEXTURE_2D, mipmap_level, GL_RGBA, width, height, border,
-                 GL_RGBA, GL_UNSIGNED_BYTE, &img.raw_image[0]);
+    width  = img.width;
+    height = img.height;
+
+    GLint mipmap_level = 0;
+    GLint border       = 0;
+    glTexImage2D(GL_TEXTURE_2D, mipmap_level, GL_RGBA,
+                 static_cast<GLsizei>(width), static_cast<GLsizei>(height),
+                 border, GL_RGBA, GL_UNSIGNED_BYTE, &img.raw_image[0]);
     OM_GL_CHECK();
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -1404,10 +2320,31 @@ texture_gl_es20::texture_gl_es20(std::string_view path)
     OM_GL_CHECK();
 }
 
+texture_gl_es20::texture_gl_es20(const texture_gl_es20& page,
+                                 std::string_view name, std::uint32_t x,
+                                 std::uint32_t y, std::uint32_t width_,
+                                 std::uint32_t height_)
+    : file_path(name)
+    , tex_handl(page.tex_handl)
+    , width(width_)
+    , height(height_)
+    , is_owner(false)
+{
+    const float page_width  = static_cast<float>(page.width);
+    const float page_height = static_cast<float>(page.height);
+    // page is loaded with bottom left origin
+    uv.origin = vec2(x / page_width, (page.height - y - height) / page_height);
+    uv.size   = vec2(width / page_width, height / page_height);
+}
+
 texture_gl_es20::~texture_gl_es20()
 {
-    glDeleteTextures(1, &tex_handl);
-    OM_GL_CHECK();
+    if (is_owner)
+    {
+        glDeleteTextures(1, &tex_handl);
+        OM_GL_CHECK();
+        gl_state.forget_texture(tex_handl);
+    }
 }
 
 void audio_callback(void*, uint8_t* stream, int stream_size)
@@ -1467,6 +2404,14 @@ window_mode get_current_window_mode()
 
 lila::~lila() = default;
 
+void lila::on_events(event_span events)
+{
+    for (event& e : events)
+    {
+        on_event(e);
+    }
+}
+
 } // end namespace om
 
 int initialize_and_start_main_loop()
@@ -1474,7 +2419,11 @@ int initialize_and_start_main_loop()
     struct start
     {
         start() {}
-        ~start() { om::uninitialize(); }
+        ~start()
+        {
+            om::dump_frame_stats();
+            om::uninitialize();
+        }
     } guard;
 
     std::vector<const char*> lib_names{ "libgamed.so", "gamed.so", "libgame.dll",
@@ -1529,6 +2478,10 @@ int initialize_and_start_main_loop()
     f_om_tat_sat =
         reinterpret_cast<std::unique_ptr<om::lila> (*)()>(func_addres);
 
+    // reload zone: from key press till new game object is initialized
+    bool                                  is_reloading = false;
+    std::chrono::steady_clock::time_point reload_start;
+
 start_game_again:
     std::unique_ptr<om::lila> game = f_om_tat_sat();
 
@@ -1549,15 +2502,21 @@ start_game_again:
 
     game->on_initialize();
 
+    if (is_reloading)
+    {
+        om::record_zone(om::zone::reload,
+                        std::chrono::steady_clock::now() - reload_start);
+        is_reloading = false;
+    }
+
     while (true)
     {
         time_point end_last_frame = timer.now();
-        om::event  event;
 
-        while (pool_event(event))
-        {
-            game->on_event(event);
-        }
+        const auto events_start = std::chrono::steady_clock::now();
+        game->on_events(om::poll_events());
+        const auto events_time =
+            std::chrono::steady_clock::now() - events_start;
 
         milli_sec frame_delta =
             std::chrono::duration_cast<milli_sec>(end_last_frame - start);
@@ -1568,19 +2527,35 @@ start_game_again:
             continue;                  // wait till more time
         }
 
-        ImGui_ImplSdlGL3_NewFrame(om::window);
+        // only events of the last busy wait iteration are counted
+        om::record_zone(om::zone::events, events_time);
 
-        game->on_update(frame_delta);
-        game->on_render();
+        ImGui_ImplSdlGL3_NewFrame(om::window);
 
-        ImGui::Render();
-        OM_GL_CHECK();
+        {
+            om::scoped_zone zone(om::zone::update);
+            game->on_update(frame_delta);
+        }
+        {
+            om::scoped_zone zone(om::zone::render);
+            game->on_render();
+            om::batch.flush();
+            om::batch.end_frame();
 
-        om::swap_buffers();
+            ImGui::Render();
+            OM_GL_CHECK();
+            om::gl_state.invalidate(); // ImGui changes it behind cache
+        }
+        {
+            om::scoped_zone zone(om::zone::swap);
+            om::swap_buffers();
+        }
         start = end_last_frame;
 
         if (om::developer_mode && om::reload_game)
         {
+            reload_start = std::chrono::steady_clock::now();
+            is_reloading = true;
             goto start_game_again;
         }
     }
@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <variant>
+#include <vector>
 
 #ifndef OM_DECLSPEC
 #define OM_DECLSPEC
@@ -101,6 +102,23 @@ public:
     virtual std::uint32_t get_height() const = 0;
 };
 
+/// how often vertexes of vbo change, hint for GL driver
+enum class vbo_usage
+{
+    static_draw,  // never, level geometry
+    dynamic_draw, // sometimes, update() gives driver new memory
+    stream_draw   // every frame
+};
+
+/// how render() draws vbo
+enum class vbo_draw
+{
+    batch_small, // up to 64 vertexes are copied into sprite batch
+    own_buffer   // always from its GPU buffer, level drawn every frame
+};
+
+/// vertexes in GPU memory, copy stays in RAM for batching of small meshes;
+/// GPU buffer is made on first draw from it, batched mesh never has it
 class OM_DECLSPEC vbo
 {
 public:
@@ -108,6 +126,15 @@ public:
     virtual const vertex* data() const = 0;
     /// count of vertexes
     virtual size_t size() const = 0;
+    /// vertexes to draw in order, nullptr if mesh has no index buffer
+    virtual const std::uint16_t* indexes() const     = 0;
+    virtual size_t               index_count() const = 0;
+    virtual vbo_usage            usage() const       = 0;
+    virtual vbo_draw             draw_path() const   = 0;
+    /// replace mesh, GPU does not wait draws of old data
+    virtual void update(const vertex*, std::size_t,
+                        const std::uint16_t* indexes        = nullptr,
+                        std::size_t          num_of_indexes = 0) = 0;
 };
 
 class OM_DECLSPEC sound
@@ -201,14 +228,44 @@ window_mode OM_DECLSPEC get_current_window_mode();
 /// return seconds from initialization
 float OM_DECLSPEC get_time_from_init();
 
+/// events of one frame, contiguous, valid till next poll_events()
+struct OM_DECLSPEC event_span
+{
+    event* first = nullptr;
+    size_t count = 0;
+
+    event* begin() const { return first; }
+    event* end() const { return first + count; }
+    size_t size() const { return count; }
+    bool   empty() const { return count == 0; }
+};
+
+/// all input since previous call in one pass, call once per frame
+event_span OM_DECLSPEC poll_events();
+
+/// one event at a time from events of poll_events(), do not mix them
 bool OM_DECLSPEC pool_event(event& e);
 
 bool OM_DECLSPEC is_key_down(const enum keys);
 
+/// read table made by tools/atlas_packer, after it create_texture() of
+/// packed image gives its part of atlas page, so sprites of different
+/// images are batched into one draw call; texture coordinates of meshes
+/// have to stay in 0..1, atlas image can't repeat
+void OM_DECLSPEC load_texture_atlas(std::string_view path);
+
 texture* OM_DECLSPEC create_texture(std::string_view path);
 void OM_DECLSPEC destroy_texture(texture* t);
 
-vbo* OM_DECLSPEC create_vbo(const vertex*, std::size_t);
+vbo* OM_DECLSPEC create_vbo(const vertex*, std::size_t,
+                            vbo_usage usage = vbo_usage::static_draw,
+                            vbo_draw  draw  = vbo_draw::batch_small);
+/// primitives are built from vertexes in order of indexes
+vbo* OM_DECLSPEC create_vbo(const vertex*, std::size_t,
+                            const std::uint16_t* indexes,
+                            std::size_t          num_of_indexes,
+                            vbo_usage            usage = vbo_usage::static_draw,
+                            vbo_draw             draw  = vbo_draw::batch_small);
 void OM_DECLSPEC destroy_vbo(vbo*);
 
 sound* OM_DECLSPEC create_sound(std::string_view path);
@@ -224,11 +281,43 @@ enum class primitives
     trianglfan
 };
 
+/// small mesh is not drawn at once: calls with same texture and kind of
+/// primitive (triangles or lines) in a row are merged into one draw call,
+/// batch is drawn before ImGui at end of frame or when texture changes;
+/// big mesh is drawn from its own GPU buffer without upload
 void OM_DECLSPEC render(const enum primitives, const vbo&, const texture*,
                         const matrix&);
 
+/// draw calls of one frame
+struct OM_DECLSPEC render_stats
+{
+    size_t render_calls    = 0; // om::render() calls
+    size_t draw_calls      = 0; // glDrawArrays() and glDrawElements() calls
+    size_t vertexes        = 0; // vertexes drawn
+    size_t upload_bytes    = 0; // vertexes and indexes copied to GPU
+    size_t elided_gl_calls = 0; // skipped, GL state was already the same
+};
+
+/// stats of last finished frame
+render_stats OM_DECLSPEC get_render_stats();
+
 void OM_DECLSPEC exit(int return_code);
 
+/// time spent in one part of frame: events, update, render, swap, reload
+struct OM_DECLSPEC zone_stats
+{
+    std::string              name;
+    std::chrono::nanoseconds p50{ 0 };
+    std::chrono::nanoseconds p95{ 0 };
+    std::chrono::nanoseconds p99{ 0 };
+    std::chrono::nanoseconds max{ 0 };
+    size_t                   samples = 0; // frames in sliding window
+};
+
+/// percentiles of zone durations over the last frames, also printed to
+/// log on exit
+std::vector<zone_stats> OM_DECLSPEC get_frame_stats();
+
 extern OM_DECLSPEC std::ostream& log;
 
 struct OM_DECLSPEC lila
@@ -236,6 +325,8 @@ struct OM_DECLSPEC lila
     virtual ~lila();
     virtual void on_initialize()                                  = 0;
     virtual void on_event(om::event&)                             = 0;
+    /// all events of frame, calls on_event() for every one by default
+    virtual void on_events(event_span events);
     virtual void on_update(std::chrono::milliseconds frame_delta) = 0;
     virtual void on_render() const                                = 0;
 };
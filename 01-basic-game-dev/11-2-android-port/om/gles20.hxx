@@ -38,6 +38,7 @@ extern PFNGLVERTEXATTRIBPOINTERPROC      glVertexAttribPointer;
 extern PFNGLENABLEVERTEXATTRIBARRAYPROC  glEnableVertexAttribArray;
 extern PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
 extern PFNGLGETUNIFORMLOCATIONPROC       glGetUniformLocation;
+extern PFNGLGETACTIVEUNIFORMPROC         glGetActiveUniform;
 extern PFNGLUNIFORM1IPROC                glUniform1i;
 extern PFNGLACTIVETEXTUREPROC            glActiveTexture;
 extern PFNGLUNIFORM4FVPROC               glUniform4fv;
@@ -45,6 +46,7 @@ extern PFNGLUNIFORMMATRIX3FVPROC         glUniformMatrix3fv;
 extern PFNGLUNIFORMMATRIX4FVPROC         glUniformMatrix4fv;
 extern PFNGLBINDBUFFERPROC               glBindBuffer;
 extern PFNGLBUFFERDATAPROC               glBufferData;
+extern PFNGLBUFFERSUBDATAPROC            glBufferSubData;
 extern PFNGLGENBUFFERSPROC               glGenBuffers;
 extern PFNGLGETATTRIBLOCATIONPROC        glGetAttribLocation;
 extern PFNGLBLENDFUNCSEPARATEPROC        glBlendFuncSeparate;
@@ -0,0 +1,475 @@
+// Packs all png images under directory into few atlas textures, so game
+// draws sprites of different images with one texture and one draw call.
+//
+// usage: atlas_packer <images_dir> <atlas_prefix> [max_page_size]
+// example: atlas_packer res res/textures
+// max_page_size is power of two, 2048 by default
+//
+// writes pages <atlas_prefix>_0.png, <atlas_prefix>_1.png ... and table
+// <atlas_prefix>.atlas with rect of every image in pixels, image name is
+// its path as game gives it to om::create_texture(), "res/tank.png" for
+// example. om::load_texture_atlas() reads the table.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "om/picopng.hxx"
+
+namespace fs = std::filesystem;
+
+struct rect
+{
+    std::uint32_t x      = 0;
+    std::uint32_t y      = 0;
+    std::uint32_t width  = 0;
+    std::uint32_t height = 0;
+};
+
+struct image
+{
+    std::string               name;
+    std::vector<std::uint8_t> rgba; // top left origin
+    std::uint32_t             width  = 0;
+    std::uint32_t             height = 0;
+    std::size_t               page   = 0;
+    rect                      place; // without padding
+};
+
+/// MaxRects bin packer with best short side fit: keeps all maximal free
+/// rectangles of page, new rect goes to free one where it leaves least
+/// space along shorter side
+class max_rects
+{
+public:
+    max_rects(std::uint32_t width, std::uint32_t height)
+        : free_rects{ rect{ 0, 0, width, height } }
+    {
+    }
+
+    bool insert(std::uint32_t width, std::uint32_t height, rect& result)
+    {
+        std::uint32_t best_short = std::numeric_limits<std::uint32_t>::max();
+        std::uint32_t best_long  = std::numeric_limits<std::uint32_t>::max();
+        for (const rect& free : free_rects)
+        {
+            if (free.width < width || free.height < height)
+            {
+                continue;
+            }
+            const std::uint32_t left_x = free.width - width;
+            const std::uint32_t left_y = free.height - height;
+            const std::uint32_t short_side = std::min(left_x, left_y);
+            const std::uint32_t long_side  = std::max(left_x, left_y);
+            if (short_side < best_short ||
+                (short_side == best_short && long_side < best_long))
+            {
+                best_short = short_side;
+                best_long  = long_side;
+                result     = rect{ free.x, free.y, width, height };
+            }
+        }
+        if (best_short == std::numeric_limits<std::uint32_t>::max())
+        {
+            return false;
+        }
+        split(result);
+        return true;
+    }
+
+private:
+    static bool intersects(const rect& a, const rect& b)
+    {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+            a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    static bool contains(const rect& outer, const rect& inner)
+    {
+        return inner.x >= outer.x && inner.y >= outer.y &&
+            inner.x + inner.width <= outer.x + outer.width &&
+            inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    /// every free rect under used one is replaced with up to four free
+    /// rects around it
+    void split(const rect& used)
+    {
+        std::vector<rect> result;
+        for (const rect& free : free_rects)
+        {
+            if (!intersects(free, used))
+            {
+                result.push_back(free);
+                continue;
+            }
+            if (used.x > free.x)
+            {
+                result.push_back(
+                    rect{ free.x, free.y, used.x - free.x, free.height });
+            }
+            if (used.x + used.width < free.x + free.width)
+            {
+                const std::uint32_t x = used.x + used.width;
+                result.push_back(
+                    rect{ x, free.y, free.x + free.width - x, free.height });
+            }
+            if (used.y > free.y)
+            {
+                result.push_back(
+                    rect{ free.x, free.y, free.width, used.y - free.y });
+            }
+            if (used.y + used.height < free.y + free.height)
+            {
+                const std::uint32_t y = used.y + used.height;
+                result.push_back(
+                    rect{ free.x, y, free.width, free.y + free.height - y });
+            }
+        }
+        // drop rects inside other free rects
+        free_rects.clear();
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            bool is_inside = false;
+            for (std::size_t j = 0; j < result.size() && !is_inside; ++j)
+            {
+                // of two equal rects first one is kept
+                is_inside = i != j && contains(result[j], result[i]) &&
+                    !(contains(result[i], result[j]) && i < j);
+            }
+            if (!is_inside)
+            {
+                free_rects.push_back(result[i]);
+            }
+        }
+    }
+
+    std::vector<rect> free_rects;
+};
+
+static image load_image(const fs::path& path, const std::string& name)
+{
+    std::ifstream file(path, std::ios::binary);
+    const std::vector<char> bytes{ std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>() };
+    std::unique_ptr<char[]> mem = std::make_unique<char[]>(bytes.size());
+    std::copy(begin(bytes), end(bytes), mem.get());
+    const om::membuf buf(std::move(mem), bytes.size());
+
+    om::png_image png = om::decode_png_file_from_memory(
+        buf, om::convert_color::to_rgba32, om::origin_point::top_left);
+    if (png.error != 0)
+    {
+        throw std::runtime_error("can't decode png: " + path.string());
+    }
+    image result;
+    result.name   = name;
+    result.rgba   = std::move(png.raw_image);
+    result.width  = png.width;
+    result.height = png.height;
+    return result;
+}
+
+/// packs images from first in order of size, returns how many fit
+static std::size_t pack_page(std::vector<image*>& images, std::size_t page,
+                             std::uint32_t width, std::uint32_t height,
+                             std::uint32_t padding)
+{
+    max_rects   packer(width, height);
+    std::size_t count = 0;
+    for (image* img : images)
+    {
+        rect place;
+        if (packer.insert(img->width + 2 * padding, img->height + 2 * padding,
+                          place))
+        {
+            img->page  = page;
+            img->place = rect{ place.x + padding, place.y + padding,
+                               img->width, img->height };
+            ++count;
+        }
+        else
+        {
+            img->page = std::numeric_limits<std::size_t>::max();
+        }
+    }
+    return count;
+}
+
+/// image with edge pixels repeated into padding, so nearest and linear
+/// filtering never take color of neighbour
+static void copy_to_page(const image& img, std::vector<std::uint8_t>& page,
+                         std::uint32_t page_width, std::uint32_t padding)
+{
+    const auto pad = static_cast<std::int64_t>(padding);
+    for (std::int64_t y = -pad; y < img.height + pad; ++y)
+    {
+        for (std::int64_t x = -pad; x < img.width + pad; ++x)
+        {
+            const std::int64_t src_x =
+                std::clamp<std::int64_t>(x, 0, img.width - 1);
+            const std::int64_t src_y =
+                std::clamp<std::int64_t>(y, 0, img.height - 1);
+            const auto src =
+                static_cast<std::size_t>((src_y * img.width + src_x) * 4);
+            const auto dst = static_cast<std::size_t>(
+                ((img.place.y + y) * page_width + img.place.x + x) * 4);
+            std::copy_n(&img.rgba[src], 4, &page[dst]);
+        }
+    }
+}
+
+/// PNG with not compressed deflate blocks, picopng and any viewer read it
+static void write_png(const fs::path&                  path,
+                      const std::vector<std::uint8_t>& rgba,
+                      std::uint32_t width, std::uint32_t height)
+{
+    std::array<std::uint32_t, 256> crc_table{};
+    for (std::uint32_t n = 0; n < crc_table.size(); ++n)
+    {
+        std::uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+        {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    auto put_u32 = [](std::vector<std::uint8_t>& v, std::uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            v.push_back(static_cast<std::uint8_t>(value >> shift));
+        }
+    };
+    auto write_chunk = [&](const char* type,
+                           const std::vector<std::uint8_t>& data) {
+        std::vector<std::uint8_t> chunk;
+        put_u32(chunk, static_cast<std::uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), begin(data), end(data));
+        std::uint32_t crc = 0xFFFFFFFFu;
+        for (std::size_t i = 4; i < chunk.size(); ++i)
+        {
+            crc = crc_table[(crc ^ chunk[i]) & 0xFF] ^ (crc >> 8);
+        }
+        put_u32(chunk, crc ^ 0xFFFFFFFFu);
+        out.write(reinterpret_cast<const char*>(chunk.data()),
+                  static_cast<std::streamsize>(chunk.size()));
+    };
+
+    const std::array<std::uint8_t, 8> signature = { 137, 80, 78, 71,
+                                                    13,  10, 26, 10 };
+    out.write(reinterpret_cast<const char*>(signature.data()),
+              signature.size());
+
+    std::vector<std::uint8_t> header;
+    put_u32(header, width);
+    put_u32(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA
+    write_chunk("IHDR", header);
+
+    // every row starts with filter type 0 - none
+    std::vector<std::uint8_t> raw;
+    const std::size_t         row = std::size_t{ width } * 4;
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + y * row,
+                   rgba.begin() + (y + 1) * row);
+    }
+
+    std::vector<std::uint8_t> zlib = { 0x78, 0x01 };
+    std::size_t               pos  = 0;
+    do
+    {
+        const std::size_t size =
+            std::min<std::size_t>(raw.size() - pos, 65535);
+        const bool          last = pos + size == raw.size();
+        const std::uint16_t len  = static_cast<std::uint16_t>(size);
+        const std::uint16_t nlen = static_cast<std::uint16_t>(~len);
+        zlib.insert(zlib.end(),
+                    { static_cast<std::uint8_t>(last ? 1 : 0),
+                      static_cast<std::uint8_t>(len & 0xFF),
+                      static_cast<std::uint8_t>(len >> 8),
+                      static_cast<std::uint8_t>(nlen & 0xFF),
+                      static_cast<std::uint8_t>(nlen >> 8) });
+        zlib.insert(zlib.end(), raw.begin() + static_cast<std::ptrdiff_t>(pos),
+                    raw.begin() + static_cast<std::ptrdiff_t>(pos + size));
+        pos += size;
+    } while (pos < raw.size());
+
+    std::uint32_t a = 1;
+    std::uint32_t b = 0;
+    for (std::uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(zlib, b << 16 | a);
+    write_chunk("IDAT", zlib);
+    write_chunk("IEND", {});
+
+    if (!out)
+    {
+        throw std::runtime_error("can't write: " + path.string());
+    }
+}
+
+// pages grow by doubling, so only power of two limit is reached exactly
+static std::uint32_t parse_page_size(const std::string& text)
+{
+    std::size_t   parsed = 0;
+    unsigned long value  = 0;
+    try
+    {
+        value = std::stoul(text, &parsed);
+    }
+    catch (std::logic_error&) // invalid_argument, out_of_range
+    {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != text.size() || text[0] == '-' ||
+        value == 0 || value > std::numeric_limits<std::int32_t>::max() ||
+        (value & (value - 1)) != 0)
+    {
+        throw std::runtime_error(
+            "max_page_size has to be power of two, got: " + text);
+    }
+    return static_cast<std::uint32_t>(value);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: atlas_packer <images_dir> <atlas_prefix> "
+                     "[max_page_size]\n";
+        return EXIT_FAILURE;
+    }
+    const fs::path      images_dir = argv[1];
+    const std::string   prefix     = argv[2];
+    const std::uint32_t padding    = 1;
+
+    try
+    {
+        const std::uint32_t max_size =
+            argc > 3 ? parse_page_size(argv[3]) : 2048;
+
+        std::vector<image> images;
+        for (const auto& entry : fs::recursive_directory_iterator(images_dir))
+        {
+            const std::string name = entry.path().generic_string();
+            // pages of previous run are not packed again
+            if (entry.is_regular_file() && entry.path().extension() == ".png" &&
+                name.rfind(fs::path(prefix).generic_string() + '_', 0) != 0)
+            {
+                images.push_back(load_image(entry.path(), name));
+            }
+        }
+        if (images.empty())
+        {
+            throw std::runtime_error("no png images in: " +
+                                     images_dir.string());
+        }
+
+        // big images first, they are hardest to place
+        std::vector<image*> rest;
+        for (image& img : images)
+        {
+            if (img.width + 2 * padding > max_size ||
+                img.height + 2 * padding > max_size)
+            {
+                throw std::runtime_error("image is bigger than page: " +
+                                         img.name);
+            }
+            rest.push_back(&img);
+        }
+        std::sort(begin(rest), end(rest), [](const image* l, const image* r) {
+            return std::max(l->width, l->height) >
+                std::max(r->width, r->height) ||
+                (std::max(l->width, l->height) ==
+                     std::max(r->width, r->height) &&
+                 l->width * l->height > r->width * r->height);
+        });
+
+        std::vector<std::array<std::uint32_t, 2>> page_sizes;
+        while (!rest.empty())
+        {
+            const std::size_t page = page_sizes.size();
+            // smallest power of two page for all images left, if even
+            // biggest page is not enough the rest goes to next page
+            std::uint32_t width  = std::min<std::uint32_t>(16, max_size);
+            std::uint32_t height = width;
+            while (pack_page(rest, page, width, height, padding) !=
+                       rest.size() &&
+                   (width < max_size || height < max_size))
+            {
+                if (width <= height && width < max_size)
+                {
+                    width *= 2;
+                }
+                else
+                {
+                    height *= 2;
+                }
+            }
+            page_sizes.push_back({ width, height });
+            rest.erase(std::remove_if(begin(rest), end(rest),
+                                      [page](const image* img) {
+                                          return img->page == page;
+                                      }),
+                       end(rest));
+        }
+
+        std::ofstream table(prefix + ".atlas");
+        table << "num_of_pages " << page_sizes.size() << '\n';
+        for (std::size_t page = 0; page < page_sizes.size(); ++page)
+        {
+            const auto [width, height] = page_sizes[page];
+            std::vector<std::uint8_t> pixels(std::size_t{ width } * height *
+                                             4);
+            for (const image& img : images)
+            {
+                if (img.page == page)
+                {
+                    copy_to_page(img, pixels, width, padding);
+                }
+            }
+            const std::string page_path =
+                prefix + '_' + std::to_string(page) + ".png";
+            write_png(page_path, pixels, width, height);
+            table << "page " << page_path << '\n';
+            std::cout << page_path << ": " << width << 'x' << height << '\n';
+        }
+
+        table << "num_of_images " << images.size() << '\n';
+        for (const image& img : images)
+        {
+            table << img.name << ' ' << img.page << ' ' << img.place.x << ' '
+                  << img.place.y << ' ' << img.width << ' ' << img.height
+                  << '\n';
+        }
+        if (!table)
+        {
+            throw std::runtime_error("can't write: " + prefix + ".atlas");
+        }
+        std::cout << images.size() << " images in " << page_sizes.size()
+                  << " pages" << std::endl;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,7 +1,16 @@
 #pragma once
 
+#include "om/jobs.hxx"
+#include "om/resources.hxx"
+
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <new>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #if !defined(OM_EXP)
 #ifdef _WIN32
@@ -13,6 +22,93 @@
 
 namespace om
 {
+// Memory owned by engine, it outlives reload of game library. Game keeps
+// state here and new library instance finds it by name. State must not
+// point to code or static data of the library, they are unloaded.
+class OM_EXP state_arena
+{
+public:
+    state_arena();
+    ~state_arena();
+    state_arena(const state_arena&)            = delete;
+    state_arena& operator=(const state_arena&) = delete;
+
+    // block with this name, zeroed when it is created; if size or
+    // alignment differ (state layout changed) old block is dropped
+    [[nodiscard]] void* get(std::string_view name,
+                            size_t           size,
+                            size_t           alignment);
+    // nullptr if there is no such block of this size and alignment
+    [[nodiscard]] void* find(std::string_view name,
+                             size_t           size,
+                             size_t           alignment) const;
+    // T is value initialized once, destructor is never called
+    template <typename T>
+    T& get(std::string_view name);
+    template <typename T>
+    T* find(std::string_view name) const;
+
+    void clear(); // all blocks, memory is reused
+
+private:
+    struct impl;
+    impl* pImpl = nullptr;
+};
+
+template <typename T>
+T& state_arena::get(std::string_view name)
+{
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arena never calls destructors");
+    if (T* state = find<T>(name))
+        return *state;
+    return *new (get(name, sizeof(T), alignof(T))) T{};
+}
+
+template <typename T>
+T* state_arena::find(std::string_view name) const
+{
+    return static_cast<T*>(find(name, sizeof(T), alignof(T)));
+}
+
+// Dandy gamepad emulation
+enum class keys : std::uint8_t
+{
+    left,
+    right,
+    up,
+    down,
+    select,
+    start,
+    button1,
+    button2
+};
+
+enum class event_type : std::uint8_t
+{
+    key_down,
+    key_up,
+    quit // window is closed
+};
+
+// compact, copied by value and written to input record as is
+struct event
+{
+    event_type type = event_type::quit;
+    keys       key  = keys::left; // key_down and key_up only
+};
+
+// time spent in one part of frame (events, update, draw, reload)
+struct zone_stats
+{
+    std::string              name;
+    std::chrono::nanoseconds p50{ 0 };
+    std::chrono::nanoseconds p95{ 0 };
+    std::chrono::nanoseconds p99{ 0 };
+    std::chrono::nanoseconds max{ 0 };
+    size_t                   samples{ 0 }; // frames in sliding window
+};
+
 struct OM_EXP engine
 {
     struct params
@@ -24,9 +120,23 @@ struct OM_EXP engine
         };
         window_mode wnd_mode;
         std::string title;
+        double      frame_rate      = 60.0; // 0 - no limit
+        double      update_rate     = 60.0; // fixed game::update step
+        size_t      resource_budget = 256 * 1024 * 1024; // bytes
     };
 
     virtual void initialize(params) = 0;
+    // part of update step passed after last game::update [0, 1),
+    // draw can interpolate between previous and current state with it
+    [[nodiscard]] virtual double get_frame_alpha() const = 0;
+    // survives game library reload, see game::serialize
+    [[nodiscard]] virtual state_arena& get_state_arena() = 0;
+    // percentiles of zone durations over the last frames
+    [[nodiscard]] virtual std::vector<zone_stats> get_frame_stats() const = 0;
+    // worker threads of engine, shared by game and engine subsystems
+    [[nodiscard]] virtual job_system& get_jobs() = 0;
+    // files decoded on worker threads, uploaded between frames
+    [[nodiscard]] virtual resource_manager& get_resources() = 0;
 
     virtual ~engine();
 };
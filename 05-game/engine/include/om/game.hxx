@@ -19,8 +19,10 @@ namespace om
 {
 struct event;
 struct engine;
+class state_arena;
 
-using milliseconds = std::chrono::milliseconds;
+// fractional, so fixed update step of 60 Hz is exact 16.666 ms
+using milliseconds = std::chrono::duration<double, std::milli>;
 
 struct OM_EXP game
 {
@@ -30,6 +32,13 @@ struct OM_EXP game
     virtual void               draw() const                     = 0;
     [[nodiscard]] virtual bool is_closed() const                = 0;
 
+    // Optional hot reload support: old instance saves its state to the
+    // arena before library is unloaded, new one adopts it instead of
+    // initialize(), so assets owned by engine are not loaded again.
+    virtual void serialize(state_arena&) const {}
+    // false - nothing to adopt, initialize() is called
+    [[nodiscard]] virtual bool restore(state_arena&) { return false; }
+
     virtual ~game();
 };
 
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined(OM_EXP)
+#ifdef _WIN32
+#define OM_EXP __declspec(dllimport)
+#else
+#define OM_EXP
+#endif
+#endif
+
+namespace om
+{
+class job_counter;
+
+// Function of job is stored inside it, so queueing a job never allocates.
+// One job takes one cache line.
+struct job
+{
+    static constexpr size_t capacity = 48; // bytes of captured state
+
+    void (*invoke)(const job& self) = nullptr;
+    job_counter* counter            = nullptr;
+    alignas(std::max_align_t) std::byte data[capacity];
+};
+
+// Jobs started with this counter and not finished yet. Counter has to
+// outlive its jobs: wait() for it before it goes out of scope.
+class OM_EXP job_counter
+{
+public:
+    job_counter()                              = default;
+    job_counter(const job_counter&)            = delete;
+    job_counter& operator=(const job_counter&) = delete;
+
+    [[nodiscard]] bool is_done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class job_system;
+
+    std::atomic<size_t> pending{ 0 };
+    std::mutex          mutex;         // continuations, error and last job
+    std::vector<job>    continuations; // queued when pending becomes 0
+    std::exception_ptr  error;         // first exception of the jobs
+};
+
+// Work stealing thread pool. Every worker has its own queue: it takes
+// newest jobs from the back of it, idle workers steal oldest jobs from
+// the front of others. Threads which are not workers (main thread) put
+// jobs into one more shared queue and help to run jobs in wait().
+// Jobs must not call om::engine, it belongs to main thread.
+class OM_EXP job_system
+{
+public:
+    // num_workers 0 - one less than hardware threads, the thread which
+    // waits is the last one; on_start is called on every worker thread
+    explicit job_system(size_t                             num_workers = 0,
+                        std::function<void(size_t worker)> on_start = {});
+    ~job_system(); // runs all queued jobs before workers stop
+    job_system(const job_system&)            = delete;
+    job_system& operator=(const job_system&) = delete;
+
+    [[nodiscard]] size_t get_worker_count() const;
+
+    // func is copied into job byte by byte, capture by reference or
+    // pointer anything bigger than few words
+    template <typename Func>
+    void run(job_counter& counter, Func&& func);
+    // job is queued only after all jobs of dependency are done
+    template <typename Func>
+    void run_after(job_counter& dependency, job_counter& counter, Func&& func);
+    // func(begin, end) for parts of [0, count) of grain size, returns when
+    // all parts are done
+    template <typename Func>
+    void parallel_for(size_t count, size_t grain, const Func& func);
+
+    // runs queued jobs (any, not only of this counter) until counter is
+    // done, then rethrows first exception thrown by its jobs
+    void wait(job_counter& counter);
+
+private:
+    template <typename Func>
+    static job make_job(job_counter& counter, Func&& func);
+    void       push(const job& task);
+    void       push_after(job_counter& dependency, const job& task);
+
+    struct impl;
+    impl* pImpl = nullptr;
+};
+
+template <typename Func>
+job job_system::make_job(job_counter& counter, Func&& func)
+{
+    using F = std::decay_t<Func>;
+    static_assert(sizeof(F) <= job::capacity &&
+                      alignof(F) <= alignof(std::max_align_t),
+                  "job function is too big, capture by reference");
+    static_assert(std::is_trivially_copyable_v<F> &&
+                      std::is_trivially_destructible_v<F>,
+                  "job is copied as bytes and never destroyed");
+    job result;
+    result.counter = &counter;
+    result.invoke  = [](const job& self)
+    { (*std::launder(reinterpret_cast<const F*>(self.data)))(); };
+    new (result.data) F(std::forward<Func>(func));
+    return result;
+}
+
+template <typename Func>
+void job_system::run(job_counter& counter, Func&& func)
+{
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    push(make_job(counter, std::forward<Func>(func)));
+}
+
+template <typename Func>
+void job_system::run_after(job_counter& dependency,
+                           job_counter& counter,
+                           Func&&       func)
+{
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    push_after(dependency, make_job(counter, std::forward<Func>(func)));
+}
+
+template <typename Func>
+void job_system::parallel_for(size_t count, size_t grain, const Func& func)
+{
+    job_counter counter;
+    const Func* body = &func;
+    grain            = std::max<size_t>(grain, 1);
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        const size_t end = begin + std::min(grain, count - begin);
+        run(counter, [body, begin, end] { (*body)(begin, end); });
+    }
+    wait(counter);
+}
+
+} // end namespace om
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "om/jobs.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace om
+{
+// slot index << 32 | generation of slot, 0 - no resource
+using handle = std::uint64_t;
+
+enum class resource_state : std::uint8_t
+{
+    empty,
+    loading, // file is read and decoded on worker thread
+    ready,
+    failed
+};
+
+// How file of one kind becomes data usable by game. Type has to outlive
+// manager or be released with release_unused() before its library is
+// unloaded.
+class OM_EXP resource_type
+{
+public:
+    virtual ~resource_type();
+    // worker thread; throws on bad file
+    [[nodiscard]] virtual void* decode(
+        std::vector<std::byte>&& file) const = 0;
+    // main thread, between frames, place to upload data to GPU
+    virtual void upload(void*) const {}
+    // bytes counted in memory budget
+    [[nodiscard]] virtual size_t get_size(const void* data) const = 0;
+    virtual void                 destroy(void* data) const        = 0;
+};
+
+// File contents as std::vector<std::byte>
+class OM_EXP bytes_type final : public resource_type
+{
+public:
+    void*  decode(std::vector<std::byte>&& file) const final;
+    size_t get_size(const void* data) const final;
+    void   destroy(void* data) const final;
+};
+
+class resource_manager;
+
+// Copyable counted reference to loaded resource, like std::shared_ptr but
+// only one handle inside. Main thread only, has to be released before
+// engine is destroyed.
+class OM_EXP resource
+{
+public:
+    resource() = default;
+    resource(const resource& other);
+    resource(resource&& other) noexcept;
+    resource& operator=(resource other) noexcept;
+    ~resource();
+
+    [[nodiscard]] resource_state   get_state() const;
+    [[nodiscard]] bool             is_ready() const;
+    [[nodiscard]] std::string_view get_path() const;
+    [[nodiscard]] handle           get_handle() const { return h; }
+    // decoded data, nullptr until resource is ready
+    [[nodiscard]] void* get_data() const;
+    template <typename T>
+    [[nodiscard]] T* get() const
+    {
+        return static_cast<T*>(get_data());
+    }
+
+    friend bool operator==(const resource& left, const resource& right)
+    {
+        return left.h == right.h;
+    }
+
+private:
+    friend class resource_manager;
+    resource(resource_manager* owner, handle h);
+
+    resource_manager* owner = nullptr;
+    handle            h     = 0;
+};
+
+struct resource_stats
+{
+    size_t loading   = 0;
+    size_t ready     = 0; // used and cached
+    size_t cached    = 0; // ready, nobody uses it, first to be evicted
+    size_t failed    = 0;
+    size_t memory    = 0; // bytes of ready resources
+    size_t budget    = 0;
+    size_t evictions = 0; // since start
+};
+
+// Resources by path: file is read and decoded once on job system, same
+// path gives the same resource while it is used or cached. Resources
+// nobody uses are kept in LRU order and evicted when memory of ready
+// resources is over budget. Main thread only.
+class OM_EXP resource_manager
+{
+public:
+    explicit resource_manager(job_system& jobs,
+                              size_t      memory_budget = 256 * 1024 * 1024);
+    ~resource_manager(); // waits for loads in flight
+    resource_manager(const resource_manager&)            = delete;
+    resource_manager& operator=(const resource_manager&) = delete;
+
+    // returns at once, resource is loading or already loaded;
+    // std::invalid_argument if path is loaded with other type
+    [[nodiscard]] resource load(std::string_view     path,
+                                const resource_type& type);
+
+    // once per frame: uploads decoded resources, not more than max_uploads
+    // so big level load does not freeze one frame; returns uploaded count
+    size_t update(size_t max_uploads = 16);
+
+    void set_memory_budget(size_t bytes);
+    // waits for loads and drops every resource nobody uses, call before
+    // library with resource types is unloaded
+    void release_unused();
+
+    [[nodiscard]] resource_stats get_stats() const;
+
+private:
+    friend class resource;
+
+    void                           add_ref(handle h);
+    void                           release(handle h);
+    [[nodiscard]] resource_state   get_state(handle h) const;
+    [[nodiscard]] std::string_view get_path(handle h) const;
+    [[nodiscard]] void*            get_data(handle h) const;
+
+    struct impl;
+    impl* pImpl = nullptr;
+};
+
+} // end namespace om
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/frame_pacer.hxx"
+
+namespace
+{
+size_t count_steps(om::frame_pacer& pacer)
+{
+    size_t steps = 0;
+    while (pacer.step())
+        ++steps;
+    return steps;
+}
+} // namespace
+
+TEST_CASE("frame pacer test")
+{
+    using namespace std::chrono;
+
+    SECTION("simulated steps")
+    {
+        om::frame_pacer pacer(60.0, 50.0);
+        pacer.set_simulated(true);
+        REQUIRE(pacer.update_step() == milliseconds(20));
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            // no wait at all, time is one update step whatever happens
+            std::this_thread::sleep_for(milliseconds(frame == 3 ? 50 : 0));
+            REQUIRE(pacer.wait_next_frame() == milliseconds(20));
+            REQUIRE(count_steps(pacer) == 1);
+            REQUIRE(pacer.alpha() == 0.0);
+        }
+
+        const om::pacing_report report = pacer.get_report();
+        REQUIRE(report.frames == 10);
+        REQUIRE(report.late_frames == 0);
+        REQUIRE(report.mean_error == nanoseconds(0));
+        REQUIRE(report.max_error == nanoseconds(0));
+        REQUIRE(report.target ==
+                duration_cast<nanoseconds>(duration<double>(1.0 / 60.0)));
+    }
+    SECTION("steps are clamped after long frame")
+    {
+        om::frame_pacer pacer(0.0, 10'000.0); // 100us step, no wait
+        std::this_thread::sleep_for(milliseconds(5));
+        REQUIRE(pacer.wait_next_frame() >= milliseconds(5));
+        REQUIRE(count_steps(pacer) == 8);
+        REQUIRE(pacer.alpha() == 0.0);
+
+        std::this_thread::sleep_for(milliseconds(5));
+        pacer.restart(); // time of pause is forgotten
+        REQUIRE(!pacer.step());
+        REQUIRE(pacer.alpha() == 0.0);
+
+        const om::pacing_report report = pacer.get_report();
+        REQUIRE(report.target == nanoseconds(0));
+        REQUIRE(report.frames == 1);
+        REQUIRE(report.late_frames == 0);
+    }
+    SECTION("late frames")
+    {
+        om::frame_pacer pacer(1000.0, 60.0);
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            std::this_thread::sleep_for(milliseconds(5));
+            REQUIRE(pacer.wait_next_frame() >= milliseconds(5));
+        }
+
+        const om::pacing_report report = pacer.get_report();
+        REQUIRE(report.target == milliseconds(1));
+        REQUIRE(report.frames == 3);
+        REQUIRE(report.late_frames == 3);
+        REQUIRE(report.max_error >= milliseconds(4));
+        REQUIRE(report.mean_error >= milliseconds(4));
+        REQUIRE(report.mean_error <= report.max_error);
+        REQUIRE(report.spin_margin > nanoseconds(0));
+    }
+    SECTION("bad update rate")
+    {
+        om::frame_pacer pacer;
+        REQUIRE_THROWS_AS(pacer.set_update_rate(0.0), std::invalid_argument);
+        REQUIRE(pacer.update_step() ==
+                duration_cast<om::frame_pacer::duration>(
+                    duration<double>(1.0 / 60.0)));
+    }
+}
@@ -39,216 +39,3035 @@
  *	files: 2849
  *	folders: 635
  *	time: 1542 non-cached, 1490 cached
+ *
+ * Now both are here, see scan_backend. Linux one uses getdents64
+ * directly. scanner_benchmark, 18720 files, 584 folders, cached:
+ *
+ *	- std_filesystem: 65 ms, 159241 allocs, 23407 syscalls
+ *	- getdents:       33 ms,    714 allocs, 21652 syscalls
+ *
+ * Numbers above are history. scanner_benchmark --output file.json
+ * writes current ones, --baseline file.json compares with them.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <filesystem>
-#include <queue>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif
+
 namespace fs = std::filesystem;
 
-#include "fs_scanner.hxx"
+#include "fs_scanner.hxx"
+
+/* TODO On Windows failed skip directories with access denied. Even with
+ * fs::directory_options::skip_permission_denied option scanner tries to
+ * iterate over it and throws iterator error.
+ */
+/* TODO No exceptions, nor assert!
+ */
+
+namespace om
+{
+
+// Tree is stored in flat arrays: nodes refer to each other with indexes,
+// children of every directory are stored one after another, all names
+// are stored in one string arena. So 1M nodes tree is few big
+// allocations and destruction is just free of those arrays.
+using node_id = std::uint32_t;
+
+constexpr node_id no_node   = std::numeric_limits<node_id>::max();
+constexpr node_id root_node = 0;
+
+// FNV-1a, it can be continued from parent directory hash, so every
+// node gets hash of it's full relative path with one pass over name
+constexpr std::uint64_t path_hash_seed = 14695981039346656037ull;
+
+static std::uint64_t path_hash(std::u8string_view str,
+                               std::uint64_t      hash = path_hash_seed)
+{
+    for (char8_t c : str)
+    {
+        hash ^= static_cast<std::uint64_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct name_ref
+{
+    std::uint32_t offset = 0;
+    std::uint32_t size   = 0;
+};
+
+// Parent of removed node. Watch mode leaves removed nodes in arrays
+// till next full scan, queries skip them.
+constexpr node_id dead_node = no_node - 1;
+
+struct directory
+{
+    std::uint64_t hash  = path_hash_seed;
+    std::int64_t  mtime = 0; // last write time, to validate snapshot
+    name_ref      name{};
+    node_id       parent       = no_node;
+    node_id       first_folder = 0;
+    std::uint32_t folder_count = 0;
+    node_id       first_file   = 0;
+    std::uint32_t file_count   = 0;
+    std::int32_t  watch        = -1; // inotify watch descriptor
+};
+
+struct file
+{
+    std::uint64_t size = 0;
+    std::uint64_t hash = path_hash_seed;
+    name_ref      name{};          // full name with extension
+    std::uint32_t name_length = 0; // name without extension
+    node_id       parent      = no_node;
+};
+
+// Hash of relative path for children of directory with given hash
+static std::uint64_t children_seed(node_id dir, std::uint64_t dir_hash)
+{
+    return dir == root_node ? path_hash_seed : path_hash(u8"/", dir_hash);
+}
+
+// Array of nodes, which owns them or looks at nodes mapped from
+// snapshot file. Mapped nodes are read only: first non-const access
+// copies them to own storage, so queries never touch the heap.
+template <typename T, typename Storage = std::vector<T>>
+class flat_array
+{
+public:
+    flat_array() = default;
+    explicit flat_array(size_t count)
+        : items(count)
+    {
+    }
+
+    flat_array& operator=(Storage&& other)
+    {
+        items     = std::move(other);
+        mapped    = {};
+        is_mapped = false;
+        return *this;
+    }
+
+    void map(std::span<const T> nodes)
+    {
+        items     = Storage();
+        mapped    = nodes;
+        is_mapped = true;
+    }
+
+    Storage& edit()
+    {
+        if (is_mapped)
+        {
+            items.assign(mapped.begin(), mapped.end());
+            mapped    = {};
+            is_mapped = false;
+        }
+        return items;
+    }
+
+    void clear() { *this = Storage(); }
+
+    std::span<const T> view() const
+    {
+        return is_mapped ? mapped : std::span<const T>(items);
+    }
+
+    const T* data() const { return is_mapped ? mapped.data() : items.data(); }
+    size_t   size() const { return is_mapped ? mapped.size() : items.size(); }
+    bool     empty() const { return size() == 0; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    const T& operator[](size_t i) const
+    {
+        return is_mapped ? mapped[i] : items[i];
+    }
+    T& operator[](size_t i) { return edit()[i]; }
+
+private:
+    Storage            items;
+    std::span<const T> mapped;
+    bool               is_mapped = false;
+};
+
+// Open addressing table of node ids with linear probing. Hash is
+// kept in slot, so probing does not touch nodes until hashes match.
+class path_table
+{
+public:
+    struct slot
+    {
+        std::uint64_t hash = 0;
+        node_id       id   = no_node;
+    };
+
+    void reserve(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity < count * 2)
+            capacity <<= 1;
+        std::vector<slot> old(capacity);
+        old.swap(slots.edit());
+        used = 0;
+        for (const slot& s : old)
+        {
+            if (s.id != no_node && s.id != erased)
+                insert(s.hash, s.id);
+        }
+    }
+
+    void insert(std::uint64_t hash, node_id id)
+    {
+        if ((used + 1) * 2 > slots.size())
+            reserve(used + 1);
+        const size_t mask = slots.size() - 1;
+        size_t       i    = hash & mask;
+        while (slots[i].id != no_node)
+            i = (i + 1) & mask;
+        slots[i] = slot{ hash, id };
+        ++used;
+    }
+
+    void replace(std::uint64_t hash, node_id from, node_id to)
+    {
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i].id != no_node; i = (i + 1) & mask)
+        {
+            if (slots[i].id == from)
+            {
+                slots[i].id = to;
+                return;
+            }
+        }
+    }
+
+    // slot is not freed, so probe chains of other nodes stay valid
+    void erase(std::uint64_t hash, node_id id) { replace(hash, id, erased); }
+
+    void map(std::span<const slot> mapped, size_t used_slots)
+    {
+        slots.map(mapped);
+        used = used_slots;
+    }
+
+    std::span<const slot> get_slots() const { return slots.view(); }
+    size_t                get_used() const { return used; }
+
+    template <typename Pred>
+    node_id find(std::uint64_t hash, Pred is_match) const
+    {
+        if (slots.empty())
+            return no_node;
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i].id != no_node; i = (i + 1) & mask)
+        {
+            const slot& s = slots[i];
+            if (s.hash == hash && s.id != erased && is_match(s.id))
+                return s.id;
+        }
+        return no_node;
+    }
+
+private:
+    static constexpr node_id erased = no_node - 1;
+
+    flat_array<slot> slots;
+    size_t           used = 0; // live and erased slots
+};
+
+// Inverted index: key (extension or stem) -> files with that key. Files
+// of one key are ordered by depth first order of their directories, so
+// files of any subtree are neighbors and recursive query is two binary
+// searches plus copy of the result.
+struct file_index
+{
+    path_table          keys;    // key hash -> key id
+    flat_array<node_id> offsets; // key id -> first entry, one extra
+    flat_array<node_id> entries; // file ids grouped by key
+};
+
+// Read only view of whole file. It is mapped to memory where it is
+// possible, otherwise file is read to buffer.
+class mapped_file
+{
+public:
+    explicit mapped_file(const fs::path& path);
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file();
+
+    std::span<const std::byte> bytes() const { return { data, size }; }
+
+private:
+    const std::byte*       data = nullptr;
+    size_t                 size = 0;
+    std::vector<std::byte> buffer;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+mapped_file::mapped_file(const fs::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat info
+    {
+    };
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        const auto length = static_cast<size_t>(info.st_size);
+        void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+            data = static_cast<const std::byte*>(ptr);
+            size = length;
+        }
+    }
+    close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+    if (data != nullptr)
+        munmap(const_cast<std::byte*>(data), size);
+}
+#else
+mapped_file::mapped_file(const fs::path& path)
+{
+    std::ifstream   in(path, std::ios::binary);
+    std::error_code error;
+    const auto      length = fs::file_size(path, error);
+    if (!in || error)
+        return;
+    buffer.resize(static_cast<size_t>(length));
+    if (in.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<std::streamsize>(buffer.size())))
+    {
+        data = buffer.data();
+        size = buffer.size();
+    }
+}
+
+mapped_file::~mapped_file() = default;
+#endif
+
+// Content hash of file and size and mtime it was computed for. Records
+// are sorted by path hash of file, so they survive node id changes.
+struct file_content
+{
+    std::uint64_t path_hash = 0;
+    std::uint64_t size      = 0;
+    std::int64_t  mtime     = 0; // 0 if file was changed while hashed
+    content_hash  hash{};
+};
+
+// Snapshot file is the tree arrays and hash tables as they are in
+// memory, every section is aligned to 8 bytes. Arrays are used right
+// from mapped file, so it is valid only for the same build layout.
+struct snapshot_section
+{
+    std::uint64_t offset = 0;
+    std::uint64_t count  = 0; // elements, not bytes
+};
+
+struct snapshot_index
+{
+    std::uint64_t    used = 0; // path_table::used
+    snapshot_section slots;
+    snapshot_section offsets;
+    snapshot_section entries;
+};
+
+struct snapshot_header
+{
+    std::uint64_t    magic         = 0;
+    std::uint64_t    layout        = 0;
+    std::int64_t     scan_start    = 0; // file clock, for racy check
+    std::uint64_t    total_files   = 0;
+    std::uint64_t    total_folders = 0;
+    std::uint64_t    folder_used   = 0; // path_table::used
+    std::uint64_t    file_used     = 0;
+    snapshot_section root_path;
+    snapshot_section folders;
+    snapshot_section files;
+    snapshot_section names;
+    snapshot_section folder_slots;
+    snapshot_section file_slots;
+    snapshot_section preorder;
+    snapshot_section subtree_end;
+    snapshot_index   extensions;
+    snapshot_index   stems;
+    snapshot_section contents;
+};
+
+constexpr std::uint64_t snapshot_magic = 0x31'72'6e'63'73'5f'6d'6f; // om_scnr1
+// version of format and sizes of stored structures in one number
+constexpr std::uint64_t snapshot_layout =
+    3u | sizeof(directory) << 8 | sizeof(file) << 16 |
+    sizeof(path_table::slot) << 24 | sizeof(snapshot_header) << 32 |
+    sizeof(file_content) << 48;
+
+struct scan_worker;
+
+using change_list = std::vector<file_change>;
+
+class scanner::impl
+{
+public:
+    using file_key = std::u8string_view (impl::*)(const file&) const;
+
+    impl();
+    impl(const impl&) = delete;
+    impl(impl&&)      = delete;
+    impl& operator=(const impl&) = delete;
+    impl& operator=(impl&&) = delete;
+    ~impl();
+
+    void                  build(const scanner_options&);
+    void                  build_async(const scanner_options&);
+    void                  scan(size_t num_threads);
+    std::vector<node_id>  append_workers(std::vector<scan_worker>&);
+    void                  build_path_index(node_id first_folder,
+                                           node_id first_file);
+    void                  build_file_index();
+    file_index            make_file_index(std::span<const node_id> order,
+                                          file_key key_of) const;
+    std::span<const node_id> find_in_index(const file_index& index,
+                                           file_key           key_of,
+                                           std::u8string_view key,
+                                           node_id            dir,
+                                           bool recursive) const;
+    std::vector<file_info>   get_indexed_files(const file_index& index,
+                                               file_key           key_of,
+                                               std::u8string_view path,
+                                               std::u8string_view key,
+                                               bool recursive) const;
+    std::u8string_view    get_name(name_ref) const;
+    std::u8string_view    get_stem(const file&) const;
+    std::u8string_view    get_extension(const file&) const;
+    std::span<const file> get_child_files(node_id) const;
+    size_t                get_relative_size(node_id, name_ref) const;
+    void                  append_relative_path(node_id  parent,
+                                               name_ref name,
+                                               std::u8string& out) const;
+    void                  append_absolute_path(node_id  parent,
+                                               name_ref name,
+                                               std::u8string& out) const;
+    std::u8string         get_relative_path(node_id, name_ref) const;
+    std::u8string         get_directory_path(node_id) const;
+    std::u8string         get_file_path(const file&) const;
+    file_info             get_file_info(const file&) const;
+    node_id               skip_dead_files(node_id first, node_id last) const;
+    bool                  is_relative_path(node_id            parent,
+                                           std::u8string_view name,
+                                           std::u8string_view path) const;
+    node_id               find_child_folder(node_id, std::u8string_view) const;
+    node_id               find_child_file(node_id, std::u8string_view) const;
+    node_id               walk_directory(std::u8string_view) const;
+    node_id               find_directory(std::u8string_view) const;
+    node_id               find_file(std::u8string_view) const;
+    std::vector<node_id>  find_glob(const glob_pattern::impl&) const;
+
+    // watch mode, tree is updated in place from inotify events
+    void    start_watch();
+    void    add_watch(node_id dir);
+    void    remove_watch(node_id dir);
+    void    read_events(change_list&);
+    void    rescan(change_list&);
+    void    add_file(node_id dir, std::u8string_view name, change_list&);
+    void    add_folder(node_id dir, std::u8string_view name, change_list&);
+    void    remove_file(node_id, change_list&);
+    void    remove_folder(node_id, change_list&);
+    void    kill_subtree(node_id dir, change_list&);
+    node_id grow_files(node_id dir);
+    node_id grow_folders(node_id dir);
+    void    move_folder(node_id from, node_id to);
+
+    // snapshot, tree is mapped from file and only changed directories
+    // are scanned again
+    void scan_with_snapshot(const fs::path&, size_t num_threads);
+    bool load_snapshot(const fs::path&, size_t num_threads);
+    bool save_snapshot(const fs::path&) const;
+    std::vector<node_id> find_changed_folders(std::int64_t racy_limit,
+                                              size_t       num_threads) const;
+    void refresh_directory(node_id dir, change_list&);
+    void compact();
+
+    // content hashes, old records are reused if size and mtime match;
+    // records of removed path hashes are dropped unless read again
+    size_t update_contents(std::span<const node_id>       ids,
+                           bool                           all_files,
+                           std::span<const std::uint64_t> removed = {});
+    void   update_contents(const change_list&);
+    const file_content* find_content(const file&) const;
+
+    // tree is locked only while it is scanned in background
+    std::shared_lock<std::shared_mutex> read_lock() const;
+    std::unique_lock<std::shared_mutex> write_lock();
+
+    std::u8string                      root_path;
+    flat_array<directory>              folders; // folders[0] is root
+    flat_array<file>                   files;
+    flat_array<char8_t, std::u8string> names;
+    path_table                         folder_paths;
+    path_table                         file_paths;
+    flat_array<node_id>                preorder;    // folder -> position
+    flat_array<node_id>                subtree_end; // folder -> position
+    file_index                         extensions;
+    file_index                         stems;
+    flat_array<file_content>           contents; // sorted by path hash
+    std::vector<thread_report>         threads;
+    std::unordered_map<int, node_id>   watches; // descriptor -> folder
+    std::unique_ptr<mapped_file>       snapshot;
+    size_t                             total_files{ 0 };
+    size_t                             total_folders{ 0 };
+    size_t                             updated_folders{ 0 };
+    size_t                             hashed_files{ 0 };
+    size_t                             num_threads{ 1 }; // hashing, rescan
+    std::chrono::milliseconds          scan_time{ 0 };
+    std::chrono::milliseconds          hash_time{ 0 };
+    mutable std::shared_mutex          tree_mutex;
+    mutable std::mutex                 tree_gate; // writer is not starved
+    std::thread                        loader; // with async option
+    std::promise<void>                 loaded;
+    std::shared_future<void>           loaded_future{ loaded.get_future() };
+    std::atomic<size_t>                visited_folders{ 0 };
+    std::atomic<size_t>                visited_files{ 0 };
+    std::atomic<bool>                  is_loading{ false };
+    std::atomic<bool>                  is_stopping{ false };
+    fs::file_time_type                 scan_start{};
+    scan_backend                       backend{ scan_backend::std_filesystem };
+    int                                watch_fd{ -1 };
+    bool                               is_initialized{ false };
+    bool                               from_snapshot{ false };
+    bool                               hash_contents{ false };
+    std::byte                          padding[1] = {};
+};
+
+scanner::impl::impl()
+    : folders(1)
+{
+}
+
+scanner::impl::~impl()
+{
+    is_stopping = true;
+    if (loader.joinable())
+        loader.join();
+#if defined(__linux__)
+    if (watch_fd >= 0)
+        close(watch_fd);
+#endif
+}
+
+// Worker local node index, global index is known only after merge
+struct node_ref
+{
+    std::uint32_t worker = 0;
+    node_id       index  = 0;
+};
+
+// node_ref::worker of node, which is already moved to the tree
+constexpr std::uint32_t tree_worker =
+    std::numeric_limits<std::uint32_t>::max();
+
+struct scan_job
+{
+    fs::path::string_type path; // native, getdents backend needs no fs::path
+    node_ref              dir;
+    std::uint64_t         seed = path_hash_seed; // to continue for children
+};
+
+// Children of one directory, stored contiguously by scanning worker
+struct listing
+{
+    node_ref      dir;
+    node_id       first_folder = 0;
+    std::uint32_t folder_count = 0;
+    node_id       first_file   = 0;
+    std::uint32_t file_count   = 0;
+    std::int64_t  mtime        = 0;
+};
+
+// Every worker owns one queue. Owner pushes and pops from the back
+// (depth first, hot in cache), thieves take from the front, where
+// the biggest not yet visited subtrees usually are.
+class work_queue
+{
+public:
+    void push(scan_job job)
+    {
+        std::lock_guard lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+
+    bool pop(scan_job& job)
+    {
+        std::lock_guard lock(mutex);
+        if (jobs.empty())
+            return false;
+        job = std::move(jobs.back());
+        jobs.pop_back();
+        return true;
+    }
+
+    bool steal(scan_job& job)
+    {
+        std::lock_guard lock(mutex);
+        if (jobs.empty())
+            return false;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        return true;
+    }
+
+    template <typename Func>
+    void for_each(Func func)
+    {
+        std::lock_guard lock(mutex);
+        for (scan_job& job : jobs)
+            func(job);
+    }
+
+private:
+    std::mutex           mutex;
+    std::deque<scan_job> jobs;
+};
+
+// Same as fs::path::extension(), but "name." has empty extension
+// and dot is a part of the name
+static std::uint32_t get_stem_length(std::u8string_view name)
+{
+    const size_t dot = name.rfind(u8'.');
+    if (dot == std::u8string_view::npos || dot == 0 || dot + 1 == name.size())
+        return static_cast<std::uint32_t>(name.size());
+    return static_cast<std::uint32_t>(dot);
+}
+
+struct scan_worker
+{
+    work_queue             queue;
+    std::vector<directory> folders;
+    std::vector<file>      files;
+    std::vector<listing>   listings;
+    std::u8string          names;
+    thread_report          report;
+    std::uint32_t          index = 0; // in workers array
+
+    name_ref add_name(std::u8string_view name)
+    {
+        name_ref result{ static_cast<std::uint32_t>(names.size()),
+                         static_cast<std::uint32_t>(name.size()) };
+        names.append(name);
+        return result;
+    }
+
+    // Directory entry of any backend, it is scanned later as new job
+    void add_folder(const scan_job&       parent,
+                    std::u8string_view    name,
+                    fs::path::string_type path,
+                    listing&              list,
+                    std::atomic<size_t>&  pending)
+    {
+        directory tmp;
+        tmp.name = add_name(name);
+        tmp.hash = path_hash(name, parent.seed);
+        folders.push_back(tmp);
+        ++list.folder_count;
+
+        const node_ref ref{ index, static_cast<node_id>(folders.size() - 1) };
+        ++pending;
+        queue.push(
+            scan_job{ std::move(path), ref, path_hash(u8"/", tmp.hash) });
+        ++report.total_folders;
+    }
+
+    void add_file(const scan_job&    parent,
+                  std::u8string_view name,
+                  std::uint64_t      size,
+                  listing&           list)
+    {
+        file tmp;
+        tmp.name        = add_name(name);
+        tmp.name_length = get_stem_length(name);
+        tmp.hash        = path_hash(name, parent.seed);
+        tmp.size        = size;
+        files.push_back(tmp);
+        ++list.file_count;
+        ++report.total_files;
+    }
+};
+
+// Filename without temporary fs::path object where native encoding
+// is already utf8
+static std::u8string_view get_filename(const fs::path& path,
+                                       std::u8string&  buffer)
+{
+    if constexpr (std::is_same_v<fs::path::value_type, char>)
+    {
+        const std::string& native = path.native();
+        const size_t       pos    = native.rfind('/') + 1; // npos + 1 == 0
+        return { reinterpret_cast<const char8_t*>(native.data()) + pos,
+                 native.size() - pos };
+    }
+    else
+    {
+        buffer = path.filename().u8string();
+        return buffer;
+    }
+}
+
+static void iterate_directory(const scan_job&      job,
+                              scan_worker&         worker,
+                              std::atomic<size_t>& pending)
+{
+    const fs::path path(job.path);
+
+    listing list{ job.dir,
+                  static_cast<node_id>(worker.folders.size()),
+                  0,
+                  static_cast<node_id>(worker.files.size()),
+                  0,
+                  fs::last_write_time(path).time_since_epoch().count() };
+    std::u8string buffer;
+    for (const auto& p : fs::directory_iterator(path))
+    {
+        // directory_entry caches file type from directory iteration,
+        // so we do not stat every entry twice
+        if (p.is_directory())
+        {
+            worker.add_folder(job,
+                              get_filename(p.path(), buffer),
+                              p.path().native(),
+                              list,
+                              pending);
+        }
+        else if (p.is_regular_file())
+        {
+            worker.add_file(
+                job, get_filename(p.path(), buffer), p.file_size(), list);
+        }
+    }
+    worker.listings.push_back(list);
+}
+
+#if defined(__linux__)
+static std::int64_t get_mtime(const struct stat& info)
+{
+    using namespace std::chrono;
+    const sys_time<nanoseconds> time{ seconds(info.st_mtim.tv_sec) +
+                                      nanoseconds(info.st_mtim.tv_nsec) };
+    return duration_cast<fs::file_time_type::duration>(
+               file_clock::from_sys(time).time_since_epoch())
+        .count();
+}
+
+[[noreturn]] static void throw_errno(const char* what, const std::string& path)
+{
+    throw fs::filesystem_error(
+        what, path, std::error_code(errno, std::generic_category()));
+}
+
+struct file_descriptor
+{
+    int fd = -1;
+    ~file_descriptor()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+};
+
+// getdents64 returns entry types (d_type) with names, so only regular
+// files (for size) and symbolic links (followed like directory_entry
+// does) need stat. Names are used right from the kernel buffer.
+static void read_directory(const scan_job&      job,
+                           scan_worker&         worker,
+                           std::atomic<size_t>& pending)
+{
+    const file_descriptor dir{ open(
+        job.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+    struct stat           info
+    {
+    };
+    if (dir.fd < 0 || fstat(dir.fd, &info) != 0)
+        throw_errno("can't open directory", job.path);
+
+    listing list{ job.dir,
+                  static_cast<node_id>(worker.folders.size()),
+                  0,
+                  static_cast<node_id>(worker.files.size()),
+                  0,
+                  get_mtime(info) };
+
+    alignas(dirent64) char buffer[32 * 1024];
+    for (;;)
+    {
+        const long length =
+            syscall(SYS_getdents64, dir.fd, buffer, sizeof(buffer));
+        if (length < 0)
+            throw_errno("can't read directory", job.path);
+        if (length == 0)
+            break;
+
+        for (long pos = 0; pos < length;)
+        {
+            const auto* entry = reinterpret_cast<const dirent64*>(buffer + pos);
+            pos += entry->d_reclen;
+
+            const std::u8string_view name(
+                reinterpret_cast<const char8_t*>(entry->d_name));
+            if (name == u8"." || name == u8"..")
+                continue;
+
+            unsigned char type     = entry->d_type;
+            bool          has_info = false;
+            if (type == DT_LNK || type == DT_UNKNOWN)
+            {
+                if (fstatat(dir.fd, entry->d_name, &info, 0) != 0)
+                    continue; // broken link
+                type     = S_ISDIR(info.st_mode)   ? DT_DIR
+                           : S_ISREG(info.st_mode) ? DT_REG
+                                                   : DT_UNKNOWN;
+                has_info = true;
+            }
+
+            if (type == DT_DIR)
+            {
+                std::string path;
+                path.reserve(job.path.size() + 1 + name.size());
+                path = job.path;
+                if (path.back() != '/')
+                    path += '/';
+                path += entry->d_name;
+                worker.add_folder(job, name, std::move(path), list, pending);
+            }
+            else if (type == DT_REG)
+            {
+                if (!has_info && fstatat(dir.fd,
+                                         entry->d_name,
+                                         &info,
+                                         AT_SYMLINK_NOFOLLOW) != 0)
+                    continue; // removed after it was listed
+                worker.add_file(
+                    job, name, static_cast<std::uint64_t>(info.st_size), list);
+            }
+        }
+    }
+    worker.listings.push_back(list);
+}
+#endif
+
+static void scan_directory(scan_backend         backend,
+                           const scan_job&      job,
+                           scan_worker&         worker,
+                           std::atomic<size_t>& pending)
+{
+#if defined(__linux__)
+    if (backend == scan_backend::getdents)
+    {
+        read_directory(job, worker, pending);
+        return;
+    }
+#else
+    (void)backend; // std::filesystem everywhere else
+#endif
+    iterate_directory(job, worker, pending);
+}
+
+// Everything scanner options ask for, on constructor's thread or on
+// background one
+void scanner::impl::build(const scanner_options& options)
+{
+    if (options.snapshot.empty())
+        scan(options.num_threads);
+    else
+        scan_with_snapshot(options.snapshot, options.num_threads);
+
+    auto lock = write_lock();
+    if (options.hash_contents && options.snapshot.empty())
+        update_contents({}, true);
+    if (options.watch)
+        start_watch();
+    visited_folders = total_folders + 1;
+    visited_files   = total_files;
+}
+
+void scanner::impl::build_async(const scanner_options& options)
+{
+    std::exception_ptr error;
+    try
+    {
+        build(options);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    // queries after this store do not lock the tree
+    std::unique_lock lock(tree_mutex);
+    is_loading = false;
+    if (error)
+        loaded.set_exception(error);
+    else
+        loaded.set_value();
+}
+
+// Readers pass through the gate, writer holds it while it waits, so
+// queries in a loop do not keep merge of scan round out forever
+std::shared_lock<std::shared_mutex> scanner::impl::read_lock() const
+{
+    if (!is_loading.load(std::memory_order_acquire))
+        return {};
+    std::lock_guard gate(tree_gate);
+    return std::shared_lock(tree_mutex);
+}
+
+std::unique_lock<std::shared_mutex> scanner::impl::write_lock()
+{
+    if (!is_loading.load(std::memory_order_acquire))
+        return {};
+    std::lock_guard gate(tree_gate);
+    return std::unique_lock(tree_mutex);
+}
+
+void scanner::impl::scan(size_t num_threads)
+{
+    using namespace std::chrono;
+    const auto start = system_clock::now();
+    scan_start       = fs::file_time_type::clock::now();
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<scan_worker> workers(num_threads);
+    {
+        auto lock = write_lock();
+        folders.clear();
+        files.clear();
+        names.clear();
+        threads.clear();
+        folder_paths  = {};
+        file_paths    = {};
+        total_files   = 0;
+        total_folders = 0;
+        // background scan: root is in the tree from the start, so
+        // queries never see empty tree
+        if (is_loading)
+            folders.edit().emplace_back();
+    }
+
+    std::atomic<size_t> pending{ 1 }; // queued, but not finished dirs
+    std::atomic<bool>   failed{ false };
+    std::exception_ptr  error;
+    std::mutex          error_mutex;
+
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        workers[i].index = static_cast<std::uint32_t>(i);
+    }
+    node_ref root{ tree_worker, root_node };
+    if (!is_loading)
+    {
+        // root is the first node of the first worker, so it gets index 0
+        workers.front().folders.emplace_back();
+        root = node_ref{};
+    }
+    workers.front().queue.push(
+        scan_job{ fs::path(root_path).native(), root, path_hash_seed });
+
+    // Background scan goes by rounds: workers stop at deadline, found
+    // directories are added to the tree under lock, every next round is
+    // twice longer, so the tree is rebuilt only log(time) times
+    auto round    = milliseconds(16);
+    auto deadline = is_loading ? steady_clock::now() + round
+                               : steady_clock::time_point::max();
+
+    auto work = [&](size_t index)
+    {
+        const auto   worker_start = steady_clock::now();
+        scan_worker& self         = workers[index];
+        scan_job     job;
+        while (pending.load() != 0 && !failed.load() && !is_stopping.load())
+        {
+            if (deadline != steady_clock::time_point::max() &&
+                steady_clock::now() >= deadline)
+                break;
+            bool found = self.queue.pop(job);
+            for (size_t i = 1; !found && i < workers.size(); ++i)
+            {
+                found = workers[(index + i) % workers.size()].queue.steal(job);
+                if (found)
+                    ++self.report.steals;
+            }
+            if (!found)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            const size_t files_before = self.report.total_files;
+            try
+            {
+                scan_directory(backend, job, self, pending);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+            }
+            visited_folders.fetch_add(1, std::memory_order_relaxed);
+            visited_files.fetch_add(self.report.total_files - files_before,
+                                    std::memory_order_relaxed);
+            --pending;
+        }
+        self.report.scan_time += static_cast<size_t>(
+            duration_cast<milliseconds>(steady_clock::now() - worker_start)
+                .count());
+    };
+
+    std::vector<thread_report> reports(num_threads);
+    for (;;)
+    {
+        std::vector<std::thread> threads_pool;
+        threads_pool.reserve(num_threads - 1);
+        for (size_t i = 1; i < num_threads; ++i)
+        {
+            threads_pool.emplace_back(work, i);
+        }
+        work(0);
+        for (auto& t : threads_pool)
+        {
+            t.join();
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+
+        auto          lock         = write_lock();
+        const node_id first_folder = static_cast<node_id>(folders.size());
+        const node_id first_file   = static_cast<node_id>(files.size());
+        const std::vector<node_id> folder_base = append_workers(workers);
+        for (scan_worker& worker : workers)
+        {
+            // jobs left for next round point to directories of the tree
+            worker.queue.for_each(
+                [&](scan_job& job)
+                {
+                    if (job.dir.worker != tree_worker)
+                        job.dir = node_ref{ tree_worker,
+                                            folder_base[job.dir.worker] +
+                                                job.dir.index };
+                });
+            thread_report& report = reports[worker.index];
+            report.scan_time      = worker.report.scan_time;
+            report.steals         = worker.report.steals;
+            report.total_files += worker.report.total_files;
+            report.total_folders += worker.report.total_folders;
+            worker.report.total_files   = 0;
+            worker.report.total_folders = 0;
+            worker.folders.clear();
+            worker.files.clear();
+            worker.listings.clear();
+            worker.names.clear();
+        }
+        build_path_index(std::max(first_folder, root_node + 1), first_file);
+        if (pending.load() == 0 || is_stopping.load())
+            break;
+        build_file_index(); // recursive queries see scanned part too
+        round *= 2;
+        deadline = steady_clock::now() + round;
+    }
+    auto lock = write_lock();
+    threads   = std::move(reports);
+    build_file_index();
+
+    const auto finish = system_clock::now();
+    scan_time         = duration_cast<milliseconds>(finish - start);
+    is_initialized    = true;
+}
+
+// Concatenate worker arrays to the tree and turn worker local indexes
+// into global ones. Used for full scan and for subtrees in watch mode.
+// Returns first global index of folders of every worker.
+std::vector<node_id> scanner::impl::append_workers(
+    std::vector<scan_worker>& workers)
+{
+    std::vector<node_id>       folder_base;
+    std::vector<node_id>       file_base;
+    std::vector<std::uint32_t> name_base;
+    size_t                     folders_size = folders.size();
+    size_t                     files_size   = files.size();
+    size_t                     names_size   = names.size();
+    for (const auto& worker : workers)
+    {
+        folder_base.push_back(static_cast<node_id>(folders_size));
+        file_base.push_back(static_cast<node_id>(files_size));
+        name_base.push_back(static_cast<std::uint32_t>(names_size));
+        folders_size += worker.folders.size();
+        files_size += worker.files.size();
+        names_size += worker.names.size();
+    }
+
+    if (workers.size() == 1 && folders.empty())
+    {
+        folders = std::move(workers.front().folders);
+        files   = std::move(workers.front().files);
+        names   = std::move(workers.front().names);
+    }
+    else
+    {
+        folders.edit().reserve(folders_size);
+        files.edit().reserve(files_size);
+        names.edit().reserve(names_size);
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            for (directory dir : workers[w].folders)
+            {
+                dir.name.offset += name_base[w];
+                folders.edit().push_back(dir);
+            }
+            for (file fl : workers[w].files)
+            {
+                fl.name.offset += name_base[w];
+                files.edit().push_back(fl);
+            }
+            names.edit() += workers[w].names;
+        }
+    }
+
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        for (const listing& list : workers[w].listings)
+        {
+            const node_id id =
+                list.dir.worker == tree_worker
+                    ? list.dir.index
+                    : folder_base[list.dir.worker] + list.dir.index;
+            directory& dir    = folders[id];
+            dir.first_folder  = folder_base[w] + list.first_folder;
+            dir.folder_count  = list.folder_count;
+            dir.first_file    = file_base[w] + list.first_file;
+            dir.file_count    = list.file_count;
+            dir.mtime         = list.mtime;
+            for (node_id i = 0; i < dir.folder_count; ++i)
+                folders[dir.first_folder + i].parent = id;
+            for (node_id i = 0; i < dir.file_count; ++i)
+                files[dir.first_file + i].parent = id;
+        }
+        total_folders += workers[w].report.total_folders;
+        total_files += workers[w].report.total_files;
+    }
+    return folder_base;
+}
+
+void scanner::impl::build_path_index(node_id first_folder, node_id first_file)
+{
+    folder_paths.reserve(folders.size());
+    for (node_id id = first_folder; id < folders.size(); ++id)
+    {
+        folder_paths.insert(folders[id].hash, id);
+    }
+    file_paths.reserve(files.size());
+    for (node_id id = first_file; id < files.size(); ++id)
+    {
+        file_paths.insert(files[id].hash, id);
+    }
+}
+
+// Rebuilt after every change of the tree, built from live nodes only
+void scanner::impl::build_file_index()
+{
+    const auto&          self = std::as_const(*this); // keep mapped nodes
+    std::vector<node_id> order; // folders in depth first preorder
+    std::vector<node_id> position(folders.size(), no_node);
+    std::vector<node_id> end(folders.size(), no_node);
+    std::vector<node_id> stack{ root_node };
+    order.reserve(total_folders + 1);
+    while (!stack.empty())
+    {
+        const node_id dir = stack.back();
+        stack.pop_back();
+        position[dir] = static_cast<node_id>(order.size());
+        order.push_back(dir);
+        const directory& d = self.folders[dir];
+        for (node_id i = d.folder_count; i-- > 0;)
+        {
+            stack.push_back(d.first_folder + i);
+        }
+    }
+    // subtree ends where subtree of the last child ends
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const directory& d = self.folders[*it];
+        end[*it]           = d.folder_count == 0
+                                 ? position[*it] + 1
+                                 : end[d.first_folder + d.folder_count - 1];
+    }
+
+    extensions  = self.make_file_index(order, &impl::get_extension);
+    stems       = self.make_file_index(order, &impl::get_stem);
+    preorder    = std::move(position);
+    subtree_end = std::move(end);
+}
+
+file_index scanner::impl::make_file_index(std::span<const node_id> order,
+                                          file_key key_of) const
+{
+    file_index           result;
+    std::vector<node_id> file_keys(files.size(), no_node);
+    std::vector<node_id> offsets;
+    std::vector<node_id> first_files; // to compare keys while building
+
+    for (node_id dir : order)
+    {
+        const directory& d = folders[dir];
+        for (node_id id = d.first_file; id < d.first_file + d.file_count; ++id)
+        {
+            const std::u8string_view key  = (this->*key_of)(files[id]);
+            const std::uint64_t      hash = path_hash(key);
+            node_id                  k    = result.keys.find(
+                hash,
+                [&](node_id other)
+                { return (this->*key_of)(files[first_files[other]]) == key; });
+            if (k == no_node)
+            {
+                k = static_cast<node_id>(offsets.size());
+                result.keys.insert(hash, k);
+                offsets.push_back(0);
+                first_files.push_back(id);
+            }
+            ++offsets[k];
+            file_keys[id] = k;
+        }
+    }
+
+    // counts to offsets, then every file is put to its group
+    node_id total = 0;
+    for (node_id& offset : offsets)
+    {
+        total += std::exchange(offset, total);
+    }
+    offsets.push_back(total);
+
+    std::vector<node_id> entries(total);
+    std::vector<node_id> next(offsets.begin(), offsets.end() - 1);
+    for (node_id dir : order)
+    {
+        const directory& d = folders[dir];
+        for (node_id id = d.first_file; id < d.first_file + d.file_count; ++id)
+        {
+            entries[next[file_keys[id]]++] = id;
+        }
+    }
+    result.offsets = std::move(offsets);
+    result.entries = std::move(entries);
+    return result;
+}
+
+std::span<const node_id> scanner::impl::find_in_index(
+    const file_index&  index,
+    file_key           key_of,
+    std::u8string_view key,
+    node_id            dir,
+    bool               recursive) const
+{
+    const node_id k = index.keys.find(
+        path_hash(key),
+        [&](node_id other)
+        {
+            const node_id first = index.entries[index.offsets[other]];
+            return (this->*key_of)(files[first]) == key;
+        });
+    if (k == no_node)
+        return {};
+
+    const std::span<const node_id> group = index.entries.view().subspan(
+        index.offsets[k], index.offsets[k + 1] - index.offsets[k]);
+    const node_id first = preorder[dir];
+    const node_id last  = recursive ? subtree_end[dir] : first + 1;
+    auto          before = [&](node_id position)
+    {
+        return [this, position](node_id id)
+        { return preorder[files[id].parent] < position; };
+    };
+    const auto begin = std::partition_point(
+        group.begin(), group.end(), before(first));
+    const auto end = std::partition_point(begin, group.end(), before(last));
+    return { begin, end };
+}
+
+std::vector<file_info> scanner::impl::get_indexed_files(
+    const file_index&  index,
+    file_key           key_of,
+    std::u8string_view path,
+    std::u8string_view key,
+    bool               recursive) const
+{
+    std::vector<file_info> result;
+    const node_id          dir = find_directory(path);
+    if (dir == no_node)
+        return result;
+    const auto found = find_in_index(index, key_of, key, dir, recursive);
+    result.reserve(found.size());
+    for (node_id id : found)
+    {
+        result.push_back(get_file_info(files[id]));
+    }
+    return result;
+}
+
+std::u8string_view scanner::impl::get_name(name_ref name) const
+{
+    return std::u8string_view(names.data(), names.size())
+        .substr(name.offset, name.size);
+}
+
+std::u8string_view scanner::impl::get_stem(const file& fl) const
+{
+    return get_name(fl.name).substr(0, fl.name_length);
+}
+
+std::u8string_view scanner::impl::get_extension(const file& fl) const
+{
+    if (fl.name_length == fl.name.size)
+        return {};
+    return get_name(fl.name).substr(fl.name_length + 1);
+}
+
+std::span<const file> scanner::impl::get_child_files(node_id dir) const
+{
+    const directory& d = folders[dir];
+    return files.view().subspan(d.first_file, d.file_count);
+}
+
+// Check hash candidate without building it's path: compare names
+// from the node up to the root with the tail of the requested path
+bool scanner::impl::is_relative_path(node_id            parent,
+                                     std::u8string_view name,
+                                     std::u8string_view path) const
+{
+    for (;;)
+    {
+        if (!path.ends_with(name))
+            return false;
+        path.remove_suffix(name.size());
+        if (parent == root_node)
+            return path.empty();
+        if (!path.ends_with(u8'/'))
+            return false;
+        path.remove_suffix(1);
+        name   = get_name(folders[parent].name);
+        parent = folders[parent].parent;
+    }
+}
+
+node_id scanner::impl::find_child_folder(node_id            dir,
+                                         std::u8string_view name) const
+{
+    const std::uint64_t hash =
+        path_hash(name, children_seed(dir, folders[dir].hash));
+    return folder_paths.find(hash,
+                             [&](node_id id)
+                             {
+                                 const directory& d = folders[id];
+                                 return d.parent == dir &&
+                                        get_name(d.name) == name;
+                             });
+}
+
+node_id scanner::impl::find_child_file(node_id            dir,
+                                       std::u8string_view name) const
+{
+    const std::uint64_t hash =
+        path_hash(name, children_seed(dir, folders[dir].hash));
+    return file_paths.find(hash,
+                           [&](node_id id)
+                           {
+                               const file& f = files[id];
+                               return f.parent == dir &&
+                                      get_name(f.name) == name;
+                           });
+}
+
+static bool is_separator(char8_t c)
+{
+    constexpr auto preferred =
+        static_cast<char8_t>(fs::path::preferred_separator);
+    return c == u8'/' || c == preferred;
+}
+
+// Request in the same form as index keys: components are separated
+// with one '/'. If such request is not in hash index, it is not in tree.
+static bool is_normalized(std::u8string_view path)
+{
+    const auto is_alien_separator = [](char8_t c)
+    { return c != u8'/' && is_separator(c); };
+    return !path.starts_with(u8'/') && !path.ends_with(u8'/') &&
+           path.find(u8"//") == std::u8string_view::npos &&
+           std::ranges::none_of(path, is_alien_separator);
+}
+
+// Slow path for not normalized requests, like "engine//src"
+node_id scanner::impl::walk_directory(std::u8string_view path) const
+{
+    node_id result = root_node;
+    while (result != no_node && !path.empty())
+    {
+        const auto pos =
+            std::find_if(path.begin(), path.end(), is_separator) - path.begin();
+        const std::u8string_view name = path.substr(0, pos);
+        path.remove_prefix(std::min(path.size(), name.size() + 1));
+        if (!name.empty())
+            result = find_child_folder(result, name);
+    }
+    return result;
+}
+
+node_id scanner::impl::find_directory(std::u8string_view path) const
+{
+    if (path.empty())
+        return root_node;
+    const std::uint64_t hash   = path_hash(path);
+    const node_id       result = folder_paths.find(
+        hash,
+        [&](node_id id)
+        {
+            const directory& d = folders[id];
+            return is_relative_path(d.parent, get_name(d.name), path);
+        });
+    if (result != no_node || is_normalized(path))
+        return result;
+    return walk_directory(path);
+}
+
+node_id scanner::impl::find_file(std::u8string_view path) const
+{
+    const std::uint64_t hash   = path_hash(path);
+    const node_id       result = file_paths.find(
+        hash,
+        [&](node_id id)
+        {
+            const file& f = files[id];
+            return is_relative_path(f.parent, get_name(f.name), path);
+        });
+    if (result != no_node || is_normalized(path))
+        return result;
+
+    const auto separator =
+        std::find_if(path.rbegin(), path.rend(), is_separator).base();
+    const std::u8string_view name(separator, path.end());
+    if (name.empty())
+        return no_node;
+    const node_id dir = walk_directory(
+        path.substr(0, static_cast<size_t>(separator - path.begin())));
+    return dir == no_node ? no_node : find_child_file(dir, name);
+}
+
+size_t scanner::impl::get_relative_size(node_id parent, name_ref name) const
+{
+    size_t length = name.size;
+    for (node_id id = parent; id != root_node; id = folders[id].parent)
+    {
+        length += folders[id].name.size + 1;
+    }
+    return length;
+}
+
+// Relative path is built right to left, right in its place in the end
+// of out, so it does not need any temporary strings
+void scanner::impl::append_relative_path(node_id        parent,
+                                         name_ref       name,
+                                         std::u8string& out) const
+{
+    size_t length = out.size() + get_relative_size(parent, name);
+    out.resize(length, u8'/');
+    auto append = [&](name_ref n)
+    {
+        length -= n.size;
+        std::ranges::copy(get_name(n), out.begin() + length);
+        --length; // skip separator
+    };
+    append(name);
+    for (node_id id = parent; id != root_node; id = folders[id].parent)
+    {
+        append(folders[id].name);
+    }
+}
+
+void scanner::impl::append_absolute_path(node_id        parent,
+                                         name_ref       name,
+                                         std::u8string& out) const
+{
+    const bool need_separator =
+        !root_path.empty() && !is_separator(root_path.back());
+    out.reserve(out.size() + root_path.size() + need_separator +
+                get_relative_size(parent, name));
+    out += root_path;
+    if (need_separator)
+        out += static_cast<char8_t>(fs::path::preferred_separator);
+    append_relative_path(parent, name, out);
+}
+
+std::u8string scanner::impl::get_relative_path(node_id  parent,
+                                               name_ref name) const
+{
+    std::u8string result;
+    result.reserve(get_relative_size(parent, name));
+    append_relative_path(parent, name, result);
+    return result;
+}
+
+std::u8string scanner::impl::get_directory_path(node_id dir) const
+{
+    if (dir == root_node)
+        return root_path;
+    std::u8string result;
+    append_absolute_path(folders[dir].parent, folders[dir].name, result);
+    return result;
+}
+
+std::u8string scanner::impl::get_file_path(const file& fl) const
+{
+    std::u8string result;
+    append_absolute_path(fl.parent, fl.name, result);
+    return result;
+}
+
+file_info scanner::impl::get_file_info(const file& fl) const
+{
+    file_info result;
+    result.size     = fl.size;
+    result.abs_path = get_file_path(fl);
+    const file_content* content = hash_contents ? find_content(fl) : nullptr;
+    if (content != nullptr)
+        result.hash = content->hash;
+    return result;
+}
+
+node_id scanner::impl::skip_dead_files(node_id first, node_id last) const
+{
+    while (first != last && files[first].parent == dead_node)
+        ++first;
+    return first;
+}
+
+// Removed nodes only get dead parent. Range of every directory stays
+// contiguous: removal moves last child into the hole, addition moves
+// the whole range to the end of array, if it is not there yet.
+node_id scanner::impl::grow_files(node_id dir)
+{
+    const directory d = folders[dir];
+    if (d.first_file + d.file_count != files.size())
+    {
+        const auto first = static_cast<node_id>(files.size());
+        for (node_id i = 0; i < d.file_count; ++i)
+        {
+            const file fl = files[d.first_file + i];
+            files.edit().push_back(fl);
+            file_paths.replace(fl.hash, d.first_file + i, first + i);
+            files[d.first_file + i].parent = dead_node;
+        }
+        folders[dir].first_file = first;
+    }
+    files.edit().emplace_back();
+    ++folders[dir].file_count;
+    return static_cast<node_id>(files.size() - 1);
+}
+
+node_id scanner::impl::grow_folders(node_id dir)
+{
+    const directory d = folders[dir];
+    if (d.first_folder + d.folder_count != folders.size())
+    {
+        const auto first = static_cast<node_id>(folders.size());
+        folders.edit().resize(folders.size() + d.folder_count);
+        for (node_id i = 0; i < d.folder_count; ++i)
+        {
+            move_folder(d.first_folder + i, first + i);
+        }
+        folders[dir].first_folder = first;
+    }
+    folders.edit().emplace_back();
+    ++folders[dir].folder_count;
+    return static_cast<node_id>(folders.size() - 1);
+}
+
+void scanner::impl::move_folder(node_id from, node_id to)
+{
+    folders[to]        = folders[from];
+    const directory& d = folders[to];
+    folder_paths.replace(d.hash, from, to);
+    for (node_id i = 0; i < d.folder_count; ++i)
+        folders[d.first_folder + i].parent = to;
+    for (node_id i = 0; i < d.file_count; ++i)
+        files[d.first_file + i].parent = to;
+    if (d.watch >= 0)
+        watches[d.watch] = to;
+    folders[from].parent = dead_node;
+    folders[from].watch  = -1;
+}
+
+void scanner::impl::add_file(node_id            dir,
+                             std::u8string_view name,
+                             change_list&       changes)
+{
+    const fs::path  path = fs::path(get_directory_path(dir)) / name;
+    std::error_code error;
+    const auto      status = fs::status(path, error);
+    if (error || !fs::is_regular_file(status))
+        return;
+    const std::uint64_t size = fs::file_size(path, error);
+    if (error)
+        return;
+
+    node_id id = find_child_file(dir, name);
+    if (id != no_node)
+    {
+        files[id].size = size;
+        changes.push_back({ get_relative_path(dir, files[id].name),
+                            file_change::type::modified });
+        return;
+    }
+
+    id = grow_files(dir);
+    file& fl = files[id];
+    fl.name        = name_ref{ static_cast<std::uint32_t>(names.size()),
+                        static_cast<std::uint32_t>(name.size()) };
+    names.edit().append(name);
+    fl.name_length = get_stem_length(name);
+    fl.hash   = path_hash(name, children_seed(dir, folders[dir].hash));
+    fl.size   = size;
+    fl.parent = dir;
+    file_paths.insert(fl.hash, id);
+    ++total_files;
+    changes.push_back(
+        { get_relative_path(dir, fl.name), file_change::type::created });
+}
+
+void scanner::impl::add_folder(node_id            dir,
+                               std::u8string_view name,
+                               change_list&       changes)
+{
+    if (find_child_folder(dir, name) != no_node)
+        return;
+
+    // new directory can already have content (mkdir -p, mv), so it is
+    // scanned as small tree and appended to our one
+    std::vector<scan_worker> workers(1);
+    scan_worker&             worker = workers.front();
+    directory&               top    = worker.folders.emplace_back();
+    top.name = worker.add_name(name);
+    top.hash = path_hash(name, children_seed(dir, folders[dir].hash));
+    const fs::path path = fs::path(get_directory_path(dir)) / name;
+    worker.queue.push(
+        scan_job{ path.native(), node_ref{}, path_hash(u8"/", top.hash) });
+    try
+    {
+        std::atomic<size_t> pending{ 1 };
+        scan_job            job;
+        while (worker.queue.pop(job))
+            scan_directory(backend, job, worker, pending);
+    }
+    catch (const fs::filesystem_error&)
+    {
+        return; // removed while we were scanning, wait for next events
+    }
+
+    const auto first_folder = static_cast<node_id>(folders.size());
+    const auto first_file   = static_cast<node_id>(files.size());
+    append_workers(workers);
+    const auto last_folder = static_cast<node_id>(folders.size());
+    const auto last_file   = static_cast<node_id>(files.size());
+    ++total_folders;
+
+    const node_id id = grow_folders(dir);
+    move_folder(first_folder, id);
+    folders[id].parent = dir;
+    folder_paths.insert(folders[id].hash, id);
+    add_watch(id);
+    for (node_id i = first_folder + 1; i < last_folder; ++i)
+    {
+        folder_paths.insert(folders[i].hash, i);
+        add_watch(i);
+    }
+    for (node_id i = first_file; i < last_file; ++i)
+    {
+        file_paths.insert(files[i].hash, i);
+        changes.push_back({ get_relative_path(files[i].parent, files[i].name),
+                            file_change::type::created });
+    }
+}
+
+void scanner::impl::remove_file(node_id id, change_list& changes)
+{
+    const node_id dir = files[id].parent;
+    changes.push_back(
+        { get_relative_path(dir, files[id].name), file_change::type::removed });
+    file_paths.erase(files[id].hash, id);
+
+    directory&    d    = folders[dir];
+    const node_id last = d.first_file + d.file_count - 1;
+    if (id != last)
+    {
+        files[id] = files[last];
+        file_paths.replace(files[id].hash, last, id);
+    }
+    files[last].parent = dead_node;
+    --d.file_count;
+    --total_files;
+}
+
+void scanner::impl::kill_subtree(node_id dir, change_list& changes)
+{
+    const directory d = folders[dir];
+    for (node_id i = 0; i < d.folder_count; ++i)
+    {
+        kill_subtree(d.first_folder + i, changes);
+    }
+    for (node_id i = d.first_file; i < d.first_file + d.file_count; ++i)
+    {
+        changes.push_back({ get_relative_path(dir, files[i].name),
+                            file_change::type::removed });
+        file_paths.erase(files[i].hash, i);
+        files[i].parent = dead_node;
+    }
+    total_files -= d.file_count;
+    --total_folders;
+    remove_watch(dir);
+    folder_paths.erase(d.hash, dir);
+    folders[dir].parent = dead_node;
+}
+
+void scanner::impl::remove_folder(node_id id, change_list& changes)
+{
+    const node_id dir = folders[id].parent;
+    kill_subtree(id, changes);
+
+    directory&    d    = folders[dir];
+    const node_id last = d.first_folder + d.folder_count - 1;
+    if (id != last)
+        move_folder(last, id);
+    --folders[dir].folder_count;
+}
+
+void scanner::impl::rescan(change_list& changes)
+{
+    for (node_id id = 0; id < folders.size(); ++id)
+    {
+        remove_watch(id);
+    }
+    scan(num_threads);
+    start_watch();
+    changes.push_back({ std::u8string(), file_change::type::rescanned });
+}
+
+#if defined(__linux__)
+constexpr std::uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                     IN_MOVED_TO | IN_CLOSE_WRITE |
+                                     IN_ONLYDIR;
+
+void scanner::impl::start_watch()
+{
+    if (watch_fd < 0)
+        watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0)
+        return;
+    for (node_id id = 0; id < folders.size(); ++id)
+    {
+        if (id == root_node || folders[id].parent != dead_node)
+            add_watch(id);
+    }
+}
+
+void scanner::impl::add_watch(node_id dir)
+{
+    if (watch_fd < 0)
+        return;
+    const std::u8string path = get_directory_path(dir);
+    const int           wd   = inotify_add_watch(
+        watch_fd, reinterpret_cast<const char*>(path.c_str()), watch_mask);
+    if (wd < 0)
+        return;
+    folders[dir].watch = wd;
+    watches[wd]        = dir;
+}
+
+void scanner::impl::remove_watch(node_id dir)
+{
+    const int wd = folders[dir].watch;
+    if (wd < 0)
+        return;
+    inotify_rm_watch(watch_fd, wd); // fails if directory is already gone
+    watches.erase(wd);
+    folders[dir].watch = -1;
+}
+
+void scanner::impl::read_events(change_list& changes)
+{
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;)
+    {
+        const ssize_t length = read(watch_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            return; // EAGAIN, no more events
+
+        for (const char* ptr = buffer; ptr < buffer + length;)
+        {
+            const auto& event = *reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event.len;
+
+            if (event.mask & IN_Q_OVERFLOW)
+            {
+                rescan(changes);
+                return;
+            }
+            const auto it = watches.find(event.wd);
+            if (it == watches.end())
+                continue; // event of already removed directory
+            if (event.mask & IN_IGNORED)
+            {
+                folders[it->second].watch = -1;
+                watches.erase(it);
+                continue;
+            }
+            if (event.len == 0)
+                continue;
+
+            const node_id            dir = it->second;
+            const std::u8string_view name(
+                reinterpret_cast<const char8_t*>(event.name));
+            const bool is_added   = event.mask & (IN_CREATE | IN_MOVED_TO);
+            const bool is_removed = event.mask & (IN_DELETE | IN_MOVED_FROM);
+            if (event.mask & IN_ISDIR)
+            {
+                if (is_added)
+                    add_folder(dir, name, changes);
+                else if (is_removed)
+                {
+                    const node_id id = find_child_folder(dir, name);
+                    if (id != no_node)
+                        remove_folder(id, changes);
+                }
+            }
+            else if (is_removed)
+            {
+                const node_id id = find_child_file(dir, name);
+                if (id != no_node)
+                    remove_file(id, changes);
+            }
+            else
+            {
+                add_file(dir, name, changes); // created or written
+            }
+        }
+    }
+}
+#else
+void scanner::impl::start_watch() {}
+void scanner::impl::add_watch(node_id) {}
+void scanner::impl::remove_watch(node_id) {}
+void scanner::impl::read_events(change_list&) {}
+#endif
+
+template <typename T>
+static bool get_section(std::span<const std::byte> bytes,
+                        const snapshot_section&    section,
+                        std::span<const T>&        result)
+{
+    if (section.offset % alignof(std::uint64_t) != 0 ||
+        section.offset > bytes.size() ||
+        section.count > (bytes.size() - section.offset) / sizeof(T))
+        return false;
+    result = { reinterpret_cast<const T*>(bytes.data() + section.offset),
+               static_cast<size_t>(section.count) };
+    return true;
+}
+
+static bool get_index(std::span<const std::byte> bytes,
+                      const snapshot_index&      section,
+                      file_index&                result)
+{
+    std::span<const path_table::slot> slots;
+    std::span<const node_id>          offsets;
+    std::span<const node_id>          entries;
+    if (!get_section(bytes, section.slots, slots) ||
+        !get_section(bytes, section.offsets, offsets) ||
+        !get_section(bytes, section.entries, entries) || offsets.empty() ||
+        (!slots.empty() && !std::has_single_bit(slots.size())))
+        return false;
+    result.keys.map(slots, section.used);
+    result.offsets.map(offsets);
+    result.entries.map(entries);
+    return true;
+}
+
+// Directory mtime changes when entry is added, removed or renamed in it.
+// Mtime can be too coarse to see change made right after directory was
+// read, so directories changed shortly before scan are checked again.
+constexpr std::chrono::seconds racy_time{ 2 };
+
+void scanner::impl::scan_with_snapshot(const fs::path& path,
+                                       size_t          num_threads)
+{
+    bool is_loaded = false;
+    {
+        auto lock = write_lock();
+        is_loaded = load_snapshot(path, num_threads);
+    }
+    if (!is_loaded)
+        scan(num_threads); // locks the tree by itself
+
+    auto lock       = write_lock();
+    bool is_changed = !is_loaded || updated_folders != 0;
+    if (is_loaded && updated_folders != 0)
+    {
+        // incremental updates leave dead slots, do not keep them forever
+        const size_t live = total_folders + 1 + total_files;
+        if ((folders.size() + files.size() - live) * 4 > live)
+            compact();
+        build_file_index();
+    }
+    if (hash_contents && update_contents({}, true) != 0)
+        is_changed = true;
+    if (is_changed)
+        save_snapshot(path);
+}
+
+bool scanner::impl::load_snapshot(const fs::path& path, size_t num_threads)
+{
+    const auto start = std::chrono::system_clock::now();
+
+    auto file = std::make_unique<mapped_file>(path);
+
+    const std::span<const std::byte> bytes = file->bytes();
+    snapshot_header                  header;
+    if (bytes.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != snapshot_magic || header.layout != snapshot_layout)
+        return false;
+
+    std::span<const char8_t>          root;
+    std::span<const directory>        folder_nodes;
+    std::span<const om::file>         file_nodes;
+    std::span<const char8_t>          name_chars;
+    std::span<const path_table::slot> folder_slots;
+    std::span<const path_table::slot> file_slots;
+    std::span<const node_id>          folder_order;
+    std::span<const node_id>          folder_order_end;
+    file_index                        extension_index;
+    file_index                        stem_index;
+    std::span<const file_content>     content_records;
+    if (!get_section(bytes, header.root_path, root) ||
+        !get_section(bytes, header.folders, folder_nodes) ||
+        !get_section(bytes, header.files, file_nodes) ||
+        !get_section(bytes, header.names, name_chars) ||
+        !get_section(bytes, header.folder_slots, folder_slots) ||
+        !get_section(bytes, header.file_slots, file_slots) ||
+        !get_section(bytes, header.preorder, folder_order) ||
+        !get_section(bytes, header.subtree_end, folder_order_end) ||
+        !get_index(bytes, header.extensions, extension_index) ||
+        !get_index(bytes, header.stems, stem_index) ||
+        !get_section(bytes, header.contents, content_records))
+        return false;
+    if (!std::ranges::equal(root, root_path) || folder_nodes.empty() ||
+        !std::has_single_bit(folder_slots.size()) ||
+        !std::has_single_bit(file_slots.size()) ||
+        folder_order.size() != folder_nodes.size() ||
+        folder_order_end.size() != folder_nodes.size())
+        return false;
+
+    folders.map(folder_nodes);
+    files.map(file_nodes);
+    names.map(name_chars);
+    folder_paths.map(folder_slots, header.folder_used);
+    file_paths.map(file_slots, header.file_used);
+    preorder.map(folder_order);
+    subtree_end.map(folder_order_end);
+    contents.map(content_records);
+    extensions    = std::move(extension_index);
+    stems         = std::move(stem_index);
+    snapshot      = std::move(file);
+    total_files   = header.total_files;
+    total_folders = header.total_folders;
+    threads.clear();
+
+    const fs::file_time_type::duration racy =
+        std::chrono::duration_cast<fs::file_time_type::duration>(racy_time);
+    const std::vector<node_id> changed =
+        find_changed_folders(header.scan_start - racy.count(), num_threads);
+
+    // ids change while tree is updated, so changed folders are found
+    // again by path, parents first: they can remove their children
+    std::vector<std::u8string> changed_paths;
+    for (node_id id : changed)
+    {
+        changed_paths.push_back(
+            id == root_node
+                ? std::u8string()
+                : get_relative_path(folders[id].parent, folders[id].name));
+    }
+    std::ranges::sort(changed_paths, {}, &std::u8string::size);
+
+    scan_start = fs::file_time_type::clock::now();
+    change_list changes; // nobody asked about them before start
+    for (const std::u8string& changed_path : changed_paths)
+    {
+        const node_id id = find_directory(changed_path);
+        if (id == no_node)
+            continue;
+        refresh_directory(id, changes);
+        ++updated_folders;
+    }
+
+    const auto finish = std::chrono::system_clock::now();
+    scan_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
+    is_initialized = true;
+    from_snapshot  = true;
+    return true;
+}
+
+// One stat() per directory instead of reading all of them and stat() of
+// every file. Directories are checked in parallel, tree is not changed.
+std::vector<node_id> scanner::impl::find_changed_folders(
+    std::int64_t racy_limit, size_t num_threads) const
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::vector<node_id>> changed(num_threads);
+    auto                              check = [&](size_t index)
+    {
+        for (size_t id = index; id < folders.size(); id += num_threads)
+        {
+            const directory& d = folders[id];
+            if (id != root_node && d.parent == dead_node)
+                continue;
+            std::error_code error;
+            const auto      mtime =
+                fs::last_write_time(get_directory_path(id), error);
+            if (error)
+                continue; // removed, parent has changed too
+            if (mtime.time_since_epoch().count() != d.mtime ||
+                d.mtime >= racy_limit)
+                changed[index].push_back(static_cast<node_id>(id));
+        }
+    };
+
+    std::vector<std::thread> threads_pool;
+    for (size_t i = 1; i < num_threads; ++i)
+    {
+        threads_pool.emplace_back(check, i);
+    }
+    check(0);
+    for (auto& t : threads_pool)
+    {
+        t.join();
+    }
+
+    std::vector<node_id> result;
+    for (const auto& part : changed)
+    {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+// Bring children of one directory up to date with file system. New
+// subdirectories are scanned, old ones are checked on their own.
+void scanner::impl::refresh_directory(node_id dir, change_list& changes)
+{
+    const fs::path  path = get_directory_path(dir);
+    std::error_code error;
+    const auto      mtime = fs::last_write_time(path, error);
+    if (error)
+        return;
+    fs::directory_iterator it(path, error);
+    if (error)
+        return;
+    folders[dir].mtime = mtime.time_since_epoch().count();
+
+    std::vector<std::u8string> present;
+    std::u8string              buffer;
+    for (const auto& p : it)
+    {
+        const std::u8string_view name = get_filename(p.path(), buffer);
+        if (p.is_directory())
+            add_folder(dir, name, changes);
+        else if (p.is_regular_file())
+            add_file(dir, name, changes);
+        else
+            continue;
+        present.emplace_back(name);
+    }
+    std::ranges::sort(present);
+    auto is_present = [&](name_ref name)
+    {
+        return std::binary_search(
+            present.begin(), present.end(), get_name(name));
+    };
+
+    // backward, removal moves the last child to the hole
+    for (std::uint32_t i = folders[dir].file_count; i-- > 0;)
+    {
+        const node_id id = folders[dir].first_file + i;
+        if (!is_present(files[id].name))
+            remove_file(id, changes);
+    }
+    for (std::uint32_t i = folders[dir].folder_count; i-- > 0;)
+    {
+        const node_id id = folders[dir].first_folder + i;
+        if (!is_present(folders[id].name))
+            remove_folder(id, changes);
+    }
+}
+
+// Copy live nodes to new arrays in the same order as after full scan
+void scanner::impl::compact()
+{
+    std::vector<directory> new_folders;
+    std::vector<file>      new_files;
+    std::u8string          new_names;
+    new_folders.reserve(total_folders + 1);
+    new_files.reserve(total_files);
+
+    auto copy_name = [&](name_ref name)
+    {
+        const name_ref result{ static_cast<std::uint32_t>(new_names.size()),
+                               name.size };
+        new_names.append(get_name(name));
+        return result;
+    };
+
+    new_folders.push_back(folders[root_node]);
+    for (node_id id = 0; id < new_folders.size(); ++id)
+    {
+        const directory old = new_folders[id];
+        new_folders[id].first_folder =
+            static_cast<node_id>(new_folders.size());
+        for (node_id i = 0; i < old.folder_count; ++i)
+        {
+            directory d = folders[old.first_folder + i];
+            d.name      = copy_name(d.name);
+            d.parent    = id;
+            new_folders.push_back(d);
+        }
+        new_folders[id].first_file = static_cast<node_id>(new_files.size());
+        for (node_id i = 0; i < old.file_count; ++i)
+        {
+            file fl   = files[old.first_file + i];
+            fl.name   = copy_name(fl.name);
+            fl.parent = id;
+            new_files.push_back(fl);
+        }
+    }
+
+    folders      = std::move(new_folders);
+    files        = std::move(new_files);
+    names        = std::move(new_names);
+    folder_paths = {};
+    file_paths   = {};
+    build_path_index(root_node + 1, 0);
+}
+
+// File is written next to the old one and renamed, so other process
+// never maps half written snapshot. Snapshot is only a cache, so errors
+// are not reported.
+bool scanner::impl::save_snapshot(const fs::path& path) const
+{
+    snapshot_header header;
+    header.magic         = snapshot_magic;
+    header.layout        = snapshot_layout;
+    header.scan_start    = scan_start.time_since_epoch().count();
+    header.total_files   = total_files;
+    header.total_folders = total_folders;
+    header.folder_used   = folder_paths.get_used();
+    header.file_used     = file_paths.get_used();
+
+    std::vector<std::span<const std::byte>> sections;
+    std::uint64_t                           offset = sizeof(header);
+    auto add = [&](snapshot_section& section, auto elements)
+    {
+        offset         = (offset + 7) & ~std::uint64_t{ 7 };
+        section.offset = offset;
+        section.count  = elements.size();
+        sections.push_back(std::as_bytes(elements));
+        offset += sections.back().size();
+    };
+    add(header.root_path, std::span<const char8_t>(root_path));
+    add(header.folders, folders.view());
+    add(header.files, files.view());
+    add(header.names, names.view());
+    add(header.folder_slots, folder_paths.get_slots());
+    add(header.file_slots, file_paths.get_slots());
+    add(header.preorder, preorder.view());
+    add(header.subtree_end, subtree_end.view());
+    for (auto [index, section] : { std::pair{ &extensions, &header.extensions },
+                                   std::pair{ &stems, &header.stems } })
+    {
+        section->used = index->keys.get_used();
+        add(section->slots, index->keys.get_slots());
+        add(section->offsets, index->offsets.view());
+        add(section->entries, index->entries.view());
+    }
+    add(header.contents, contents.view());
+
+    fs::path      tmp_path = fs::path(path) += ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& section : sections)
+    {
+        constexpr char zeros[8]{};
+        out.write(zeros, (8 - out.tellp() % 8) % 8);
+        out.write(reinterpret_cast<const char*>(section.data()),
+                  static_cast<std::streamsize>(section.size()));
+    }
+    out.close();
+
+    std::error_code error;
+    if (out)
+        fs::rename(tmp_path, path, error);
+    if (!out || error)
+    {
+        fs::remove(tmp_path, error);
+        return false;
+    }
+    return true;
+}
+
+// Content hashing, wyhash style: 128 bit product of two words folded to
+// 64 bits. Three lanes take 48 byte blocks, so their multiplications
+// are independent and overlap in the pipeline.
+static std::uint64_t fold_multiply(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128;
+    const uint128 product = static_cast<uint128>(a) * b;
+    return static_cast<std::uint64_t>(product) ^
+           static_cast<std::uint64_t>(product >> 64);
+#else
+    const std::uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    const std::uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    const std::uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    const std::uint64_t hi_hi = (a >> 32) * (b >> 32);
+    const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    const std::uint64_t high  = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return ((cross << 32) | (lo_lo & 0xffffffff)) ^ high;
+#endif
+}
+
+static std::uint64_t load_word(const std::byte* data)
+{
+    std::uint64_t result = 0;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+class content_hasher
+{
+public:
+    void         update(std::span<const std::byte> data);
+    content_hash finish();
+
+private:
+    static constexpr size_t        block_size = 48;
+    static constexpr std::uint64_t secret[4]  = { 0xa0761d6478bd642full,
+                                                  0xe7037ed1a0b428dbull,
+                                                  0x8ebc6af09c88c6e3ull,
+                                                  0x589965cc75374cc3ull };
+
+    void add_block(const std::byte* data);
+
+    std::uint64_t lanes[3] = { secret[0], secret[1], secret[2] };
+    std::uint64_t length   = 0;
+    std::byte     tail[block_size]{};
+    size_t        tail_size = 0;
+};
+
+void content_hasher::add_block(const std::byte* data)
+{
+    for (size_t i = 0; i < 3; ++i)
+    {
+        lanes[i] = fold_multiply(load_word(data + 16 * i) ^ secret[i],
+                                 load_word(data + 16 * i + 8) ^ lanes[i]);
+    }
+}
+
+void content_hasher::update(std::span<const std::byte> data)
+{
+    length += data.size();
+    if (tail_size != 0)
+    {
+        const size_t count = std::min(block_size - tail_size, data.size());
+        std::memcpy(tail + tail_size, data.data(), count);
+        tail_size += count;
+        data = data.subspan(count);
+        if (tail_size < block_size)
+            return;
+        add_block(tail);
+        tail_size = 0;
+    }
+    for (; data.size() >= block_size; data = data.subspan(block_size))
+    {
+        add_block(data.data());
+    }
+    if (!data.empty())
+        std::memcpy(tail, data.data(), data.size());
+    tail_size = data.size();
+}
+
+content_hash content_hasher::finish()
+{
+    if (tail_size != 0)
+    {
+        std::memset(tail + tail_size, 0, block_size - tail_size);
+        add_block(tail);
+    }
+    // length tells "a" from "a\0" after zero padding
+    const std::uint64_t a =
+        fold_multiply(lanes[0] ^ secret[3], lanes[1] ^ length);
+    const std::uint64_t b = fold_multiply(lanes[1] ^ secret[0], lanes[2] ^ a);
+    const std::uint64_t c = fold_multiply(lanes[2] ^ secret[1], lanes[0] ^ b);
+    return { fold_multiply(a ^ secret[2], c ^ length),
+             fold_multiply(b ^ secret[3], c) };
+}
+
+// Fills size and mtime of record, hash is taken from old record if they
+// are the same, else file is read by large blocks. Blocks and not mmap:
+// file truncated by other process while mapped would raise SIGBUS.
+// Returns true if file was read.
+static bool read_content(const std::u8string&    path,
+                         const file_content*     old,
+                         file_content&           record,
+                         std::vector<std::byte>& buffer)
+{
+    content_hasher hasher;
+#if defined(__linux__)
+    const file_descriptor file{ open(
+        reinterpret_cast<const char*>(path.c_str()), O_RDONLY | O_CLOEXEC) };
+    struct stat info
+    {
+    };
+    if (file.fd < 0 || fstat(file.fd, &info) != 0)
+        return false; // hash stays zero
+    record.size  = static_cast<std::uint64_t>(info.st_size);
+    record.mtime = get_mtime(info);
+    if (old != nullptr && old->mtime != 0 && old->mtime == record.mtime &&
+        old->size == record.size)
+    {
+        record.hash = old->hash;
+        return false;
+    }
+    posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    for (;;)
+    {
+        const ssize_t count = read(file.fd, buffer.data(), buffer.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+        {
+            record.mtime = 0; // do not trust it next time
+            break;
+        }
+        if (count == 0)
+            break;
+        hasher.update({ buffer.data(), static_cast<size_t>(count) });
+    }
+#else
+    const fs::path  file_path(path);
+    std::error_code error;
+    record.size  = fs::file_size(file_path, error);
+    record.mtime = fs::last_write_time(file_path, error)
+                       .time_since_epoch()
+                       .count();
+    if (error)
+        return false;
+    if (old != nullptr && old->mtime != 0 && old->mtime == record.mtime &&
+        old->size == record.size)
+    {
+        record.hash = old->hash;
+        return false;
+    }
+    std::ifstream in(file_path, std::ios::binary);
+    while (in)
+    {
+        in.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<std::streamsize>(buffer.size()));
+        hasher.update({ buffer.data(), static_cast<size_t>(in.gcount()) });
+    }
+    if (!in.eof())
+        record.mtime = 0;
+#endif
+    record.hash = hasher.finish();
+    return true;
+}
+
+const file_content* scanner::impl::find_content(const file& fl) const
+{
+    const std::span<const file_content> records = contents.view();
+    const auto it = std::ranges::lower_bound(
+        records, fl.hash, {}, &file_content::path_hash);
+    return it != records.end() && it->path_hash == fl.hash ? &*it : nullptr;
+}
+
+// Threads take files by chunks from shared counter: sizes of files
+// differ a lot, so even split would wait for the slowest thread.
+size_t scanner::impl::update_contents(std::span<const node_id>       ids,
+                                      bool                           all_files,
+                                      std::span<const std::uint64_t> removed)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<node_id> live;
+    if (all_files)
+    {
+        const std::span<const file> nodes = files.view();
+        for (node_id id = 0; id < nodes.size(); ++id)
+        {
+            if (nodes[id].parent != dead_node)
+                live.push_back(id);
+        }
+        ids = live;
+    }
+
+    // file changed in the same clock tick after it was read would keep
+    // its mtime, so such records are checked again next time
+    const std::int64_t racy_limit =
+        std::chrono::time_point_cast<fs::file_time_type::duration>(
+            fs::file_time_type::clock::now() - racy_time)
+            .time_since_epoch()
+            .count();
+
+    constexpr size_t          chunk = 16;
+    std::vector<file_content> result(ids.size());
+    std::atomic<size_t>       next{ 0 };
+    std::atomic<size_t>       hashed{ 0 };
+    auto                      work = [&]
+    {
+        std::u8string          path;
+        std::vector<std::byte> buffer(size_t{ 1 } << 20);
+        for (size_t first = next.fetch_add(chunk); first < ids.size();
+             first        = next.fetch_add(chunk))
+        {
+            const size_t last = std::min(first + chunk, ids.size());
+            for (size_t i = first; i < last; ++i)
+            {
+                const file&   fl     = std::as_const(files)[ids[i]];
+                file_content& record = result[i];
+                record.path_hash     = fl.hash;
+                path.clear();
+                append_absolute_path(fl.parent, fl.name, path);
+                if (read_content(path, find_content(fl), record, buffer))
+                    ++hashed;
+                if (record.mtime >= racy_limit)
+                    record.mtime = 0;
+            }
+        }
+    };
+
+    size_t thread_count =
+        num_threads != 0 ? num_threads : std::thread::hardware_concurrency();
+    thread_count = std::clamp<size_t>(thread_count, 1, ids.size() / chunk + 1);
+    std::vector<std::thread> threads_pool;
+    threads_pool.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        threads_pool.emplace_back(work);
+    }
+    work();
+    for (auto& t : threads_pool)
+    {
+        t.join();
+    }
+
+    std::ranges::sort(result, {}, &file_content::path_hash);
+    if (!all_files)
+    {
+        // file changed twice in one batch is read twice
+        const auto [first, last] =
+            std::ranges::unique(result, {}, &file_content::path_hash);
+        result.erase(first, last);
 
-/* TODO On Windows failed skip directories with access denied. Even with
- * fs::directory_options::skip_permission_denied option scanner tries to
- * iterate over it and throws iterator error.
- */
-/* TODO No exceptions, nor assert!
- */
+        // one pass over both sorted lists: new records replace old ones
+        // of the same path, old records of removed paths are dropped
+        const std::span<const file_content> old = contents.view();
+        std::vector<file_content>           merged;
+        merged.reserve(old.size() + result.size());
+        size_t i = 0;
+        for (const file_content& record : result)
+        {
+            for (; i < old.size() && old[i].path_hash < record.path_hash; ++i)
+            {
+                if (!std::ranges::binary_search(removed, old[i].path_hash))
+                    merged.push_back(old[i]);
+            }
+            if (i < old.size() && old[i].path_hash == record.path_hash)
+                ++i;
+            merged.push_back(record);
+        }
+        for (; i < old.size(); ++i)
+        {
+            if (!std::ranges::binary_search(removed, old[i].path_hash))
+                merged.push_back(old[i]);
+        }
+        result = std::move(merged);
+    }
+    contents     = std::move(result);
+    hashed_files = hashed.load();
+    hash_time    = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return hashed_files;
+}
 
-/** FIXME
- * I don't like:
- *
- * 1) std::vector<directory*> and std::vector<file*>
- * as scanner private members. The only use is for
- * memory dealocation and get_all_files list.
- *
- * 2) ...
- */
-[[maybe_unused]] constexpr unsigned int initial_file_list_size = 8;
+// Watch mode: only created and modified files are read again, records
+// of removed files are dropped
+void scanner::impl::update_contents(const change_list& changes)
+{
+    std::vector<node_id>       ids;
+    std::vector<std::uint64_t> removed;
+    for (const file_change& change : changes)
+    {
+        if (change.what == file_change::type::rescanned)
+        {
+            update_contents({}, true);
+            return;
+        }
+        if (change.what == file_change::type::removed)
+        {
+            removed.push_back(path_hash(change.path));
+            continue;
+        }
+        const node_id id = find_file(change.path);
+        if (id != no_node)
+            ids.push_back(id);
+    }
+    if (ids.empty() && removed.empty())
+        return;
+    std::ranges::sort(removed);
+    update_contents(ids, false, removed);
+}
 
-namespace om
+// Glob is compiled to list of path components for every alternative of
+// {a,b} groups. Component is literal name, "**" or list of tokens. Tree
+// is walked with set of active components (NFA states), so directories,
+// which no state can accept, are never visited, and literal components
+// are found with hash lookup instead of iteration over all children.
+struct glob_token
 {
+    enum class type : std::uint8_t
+    {
+        literal,    // one byte
+        any_char,   // ?, one utf8 character
+        any_string, // *, without '/'
+        char_class  // [a-z], [!0-9], bytes
+    };
 
-struct file;
+    type          kind  = type::literal;
+    char8_t       value = 0;
+    std::uint16_t set   = 0; // index of class
+};
 
-struct directory
+struct glob_component
 {
-    directory*              parent = nullptr;
-    std::vector<directory*> child_folders{};
-    std::vector<file*>      child_files{};
-    std::u8string           name{};
+    enum class type : std::uint8_t
+    {
+        literal,
+        any_path, // **, zero or more directories
+        wildcard,
+        accept // after the last component of alternative
+    };
+
+    type                    kind = type::accept;
+    std::u8string           text; // literal name
+    std::vector<glob_token> tokens;
 };
 
-struct file
+class glob_pattern::impl
 {
-    size_t        size = 0;
-    std::u8string name;
-    std::u8string extension;
-    directory*    parent = nullptr;
+public:
+    explicit impl(std::u8string_view pattern);
+
+    bool is_match(std::uint32_t state, std::u8string_view name) const;
+    void add_state(std::vector<std::uint32_t>& states,
+                   std::uint32_t               state) const;
+    void advance(std::span<const std::uint32_t> states,
+                 std::u8string_view             folder,
+                 std::vector<std::uint32_t>&    result) const;
+    bool accept_file(std::span<const std::uint32_t> states,
+                     std::u8string_view             name) const;
 
-    [[nodiscard]] std::u8string get_full_name() const;
+    std::vector<glob_component>   components; // all alternatives
+    std::vector<std::uint32_t>    starts;     // first state of every one
+    std::vector<std::bitset<256>> classes;
+    bool                          is_valid = false;
+
+private:
+    bool add_alternative(std::u8string_view pattern);
+    bool add_class(std::u8string_view text, glob_component& component);
 };
 
-std::u8string file::get_full_name() const
+constexpr size_t max_glob_alternatives = 1024;
+
+// "{a,b}x{c,d}" -> "axc", "axd", "bxc", "bxd"; false as soon as there are
+// more than max_glob_alternatives, "{a,b}" repeated 20 times is not built
+static bool expand_braces(std::u8string_view          pattern,
+                          std::vector<std::u8string>& result)
 {
-    std::u8string result = name;
-    if (!extension.empty())
+    const size_t open = pattern.find(u8'{');
+    if (open == std::u8string_view::npos)
     {
-        result += '.';
-        result += extension;
+        if (pattern.find(u8'}') != std::u8string_view::npos ||
+            result.size() == max_glob_alternatives)
+            return false;
+        result.emplace_back(pattern);
+        return true;
     }
-    return result;
+    std::vector<size_t> commas;
+    size_t              depth = 0;
+    size_t              close = open;
+    for (; close < pattern.size(); ++close)
+    {
+        if (pattern[close] == u8'{')
+            ++depth;
+        else if (pattern[close] == u8'}' && --depth == 0)
+            break;
+        else if (pattern[close] == u8',' && depth == 1)
+            commas.push_back(close);
+    }
+    if (close == pattern.size())
+        return false;
+    commas.push_back(close);
+
+    const std::u8string_view head = pattern.substr(0, open);
+    const std::u8string_view tail = pattern.substr(close + 1);
+    size_t                   from = open + 1;
+    for (size_t comma : commas)
+    {
+        std::u8string alternative(head);
+        alternative += pattern.substr(from, comma - from);
+        alternative += tail;
+        if (!expand_braces(alternative, result))
+            return false;
+        from = comma + 1;
+    }
+    return true;
 }
 
-class scanner::impl
+glob_pattern::impl::impl(std::u8string_view pattern)
 {
-public:
-    impl()            = default;
-    impl(const impl&) = delete;
-    impl(impl&&)      = delete;
-    impl& operator=(const impl&) = delete;
-    impl& operator=(impl&&) = delete;
-    ~impl();
-
-    void                 scan();
-    static std::u8string get_directory_path(const directory*);
-    static std::u8string get_file_path(const file*);
-    directory*           find_directory_ptr(std::u8string_view);
-    file*                find_file_ptr(std::u8string_view);
-
-    directory                 root;
-    std::vector<directory*>   folders;
-    std::vector<file*>        files;
-    size_t                    total_files{ 0 };
-    size_t                    total_folders{ 0 };
-    std::chrono::milliseconds scan_time{ 0 };
-    bool                      is_initialized{ false };
-    std::byte                 padding[7] = {};
-};
+    std::vector<std::u8string> alternatives;
+    if (pattern.empty() || !expand_braces(pattern, alternatives))
+        return;
+    is_valid = std::ranges::all_of(alternatives,
+                                   [this](std::u8string_view alternative)
+                                   { return add_alternative(alternative); });
+}
 
-scanner::impl::~impl()
+bool glob_pattern::impl::add_alternative(std::u8string_view pattern)
 {
-    for (const auto& p : folders)
+    starts.push_back(static_cast<std::uint32_t>(components.size()));
+    while (!pattern.empty())
     {
-        delete p;
-    }
-    for (const auto& p : files)
-    {
-        delete p;
+        const size_t             slash = pattern.find(u8'/');
+        const std::u8string_view text  = pattern.substr(0, slash);
+        pattern.remove_prefix(
+            slash == std::u8string_view::npos ? pattern.size() : slash + 1);
+        if (text.empty())
+            continue;
+
+        glob_component& component = components.emplace_back();
+        if (text == u8"**")
+        {
+            component.kind = glob_component::type::any_path;
+        }
+        else if (text.find_first_of(u8"*?[") == std::u8string_view::npos)
+        {
+            component.kind = glob_component::type::literal;
+            component.text = text;
+        }
+        else
+        {
+            component.kind = glob_component::type::wildcard;
+            if (!add_class(text, component))
+                return false;
+        }
     }
+    // alternative without file name can not match any file
+    const bool has_name = components.size() > starts.back();
+    components.emplace_back(); // accept
+    return has_name;
 }
 
-void scanner::impl::scan()
+bool glob_pattern::impl::add_class(std::u8string_view text,
+                                   glob_component&    component)
 {
-    const auto start = std::chrono::system_clock::now();
-    std::queue<std::pair<fs::path, om::directory*>> recursion_queue;
-    fs::path                                        path(root.name);
-    recursion_queue.push(std::make_pair(path, &root));
-    while (!recursion_queue.empty())
+    using type = glob_token::type;
+    for (size_t i = 0; i < text.size(); ++i)
     {
-        auto pair = recursion_queue.front();
-        recursion_queue.pop();
-        for (auto& p : fs::directory_iterator(pair.first))
+        glob_token token;
+        if (text[i] == u8'*')
         {
-            if (fs::is_directory(p))
-            {
-                auto tmp = new om::directory;
-                folders.push_back(tmp);
-                tmp->name   = p.path().filename().u8string();
-                tmp->parent = pair.second;
-                pair.second->child_folders.push_back(tmp);
-                recursion_queue.push(std::make_pair(p.path(), tmp));
-                ++total_folders;
-            }
-            else if (fs::is_regular_file(p))
+            token.kind = type::any_string;
+        }
+        else if (text[i] == u8'?')
+        {
+            token.kind = type::any_char;
+        }
+        else if (text[i] == u8'[')
+        {
+            size_t     end    = i + 1;
+            const bool negate = end < text.size() &&
+                                (text[end] == u8'!' || text[end] == u8'^');
+            if (negate)
+                ++end;
+            const size_t first = end;
+            // ']' right after '[' is a member of class
+            while (end < text.size() && (text[end] != u8']' || end == first))
+                ++end;
+            if (end == text.size() || classes.size() == 0xffff)
+                return false;
+
+            std::bitset<256> set;
+            for (size_t c = first; c < end; ++c)
             {
-                file* tmp = new om::file;
-                files.push_back(tmp);
-                tmp->extension = p.path().extension().u8string();
-                tmp->name      = p.path().stem().u8string();
-                if (!tmp->extension.empty())
+                if (c + 2 < end && text[c + 1] == u8'-')
                 {
-                    if (tmp->extension == u8".")
-                        tmp->name += '.';
-                    tmp->extension.erase(0, 1);
+                    for (unsigned b = text[c]; b <= text[c + 2]; ++b)
+                        set.set(b);
+                    c += 2;
+                }
+                else
+                {
+                    set.set(text[c]);
                 }
-
-                tmp->parent = pair.second;
-                tmp->size   = fs::file_size(p);
-                pair.second->child_files.push_back(tmp);
-                ++total_files;
             }
+            if (negate)
+                set.flip();
+            token.kind = type::char_class;
+            token.set  = static_cast<std::uint16_t>(classes.size());
+            classes.push_back(set);
+            i = end;
         }
+        else
+        {
+            token.value = text[i];
+        }
+        component.tokens.push_back(token);
     }
-    const auto finish = std::chrono::system_clock::now();
-    scan_time =
-        std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
-    is_initialized = true;
-    //  std::cout << "next sizes " << file_pool.get_next_size() << " "
-    //            << directory_pool.get_next_size() << std::endl;
+    return true;
 }
 
-directory* scanner::impl::find_directory_ptr(std::u8string_view sv_path)
+static size_t get_char_length(std::u8string_view text, size_t pos)
 {
-    directory* result = &root;
-    fs::path   fs_path(sv_path);
-    for (auto& p : fs_path)
-    {
-        auto it = std::ranges::find_if(result->child_folders,
-                                       [&p](const directory* dir)
-                                       { return dir->name == p; });
-        if (it == result->child_folders.end())
-        {
-            return nullptr;
-        }
-        result = *it;
-    }
-    return result;
+    size_t length = 1;
+    while (pos + length < text.size() && (text[pos + length] & 0xc0) == 0x80)
+        ++length;
+    return length;
 }
 
-file* scanner::impl::find_file_ptr(std::u8string_view s_path)
+bool glob_pattern::impl::is_match(std::uint32_t      state,
+                                  std::u8string_view name) const
 {
-    file*          result = nullptr;
-    const fs::path fs_path(s_path);
-    directory*     dir = find_directory_ptr(fs_path.parent_path().u8string());
-    if (dir)
+    const glob_component& component = components[state];
+    if (component.kind == glob_component::type::literal)
+        return component.text == name;
+    if (component.kind != glob_component::type::wildcard)
+        return false;
+
+    // every '*' can only move forward, so one backtracking point is
+    // enough: the last '*' seen
+    using type                        = glob_token::type;
+    const std::vector<glob_token>& tk = component.tokens;
+    size_t                         t  = 0;
+    size_t                         n  = 0;
+    size_t star_token                 = std::u8string_view::npos;
+    size_t star_name                  = 0;
+    while (n < name.size())
     {
-        for (const auto& p : dir->child_files)
+        if (t < tk.size() && tk[t].kind == type::any_string)
         {
-            if (p->get_full_name() == fs_path.filename().u8string())
+            star_token = t++;
+            star_name  = n;
+            continue;
+        }
+        size_t length = 0;
+        if (t < tk.size())
+        {
+            switch (tk[t].kind)
             {
-                result = p;
+                case type::literal:
+                    length = name[n] == tk[t].value;
+                    break;
+                case type::any_char:
+                    length = get_char_length(name, n);
+                    break;
+                case type::char_class:
+                    length = classes[tk[t].set].test(name[n]);
+                    break;
+                case type::any_string:
+                    break;
             }
         }
+        if (length != 0)
+        {
+            n += length;
+            ++t;
+            continue;
+        }
+        if (star_token == std::u8string_view::npos)
+            return false;
+        t = star_token + 1;
+        star_name += get_char_length(name, star_name);
+        n = star_name;
     }
-    return result;
+    while (t < tk.size() && tk[t].kind == type::any_string)
+        ++t;
+    return t == tk.size();
+}
+
+// "**" can match zero directories, so next state is active too. Accept
+// state is never added: file is accepted by the state before it.
+void glob_pattern::impl::add_state(std::vector<std::uint32_t>& states,
+                                   std::uint32_t               state) const
+{
+    if (components[state].kind == glob_component::type::accept ||
+        std::ranges::find(states, state) != states.end())
+        return;
+    states.push_back(state);
+    if (components[state].kind == glob_component::type::any_path)
+        add_state(states, state + 1);
+}
+
+void glob_pattern::impl::advance(std::span<const std::uint32_t> states,
+                                 std::u8string_view             folder,
+                                 std::vector<std::uint32_t>&    result) const
+{
+    for (std::uint32_t state : states)
+    {
+        if (components[state].kind == glob_component::type::any_path)
+            add_state(result, state);
+        else if (components[state + 1].kind !=
+                     glob_component::type::accept &&
+                 is_match(state, folder))
+            add_state(result, state + 1);
+    }
+}
+
+bool glob_pattern::impl::accept_file(std::span<const std::uint32_t> states,
+                                     std::u8string_view             name) const
+{
+    return std::ranges::any_of(
+        states,
+        [&](std::uint32_t state)
+        {
+            return components[state + 1].kind ==
+                       glob_component::type::accept &&
+                   (components[state].kind ==
+                        glob_component::type::any_path ||
+                    is_match(state, name));
+        });
+}
+
+glob_pattern::glob_pattern(std::u8string_view pattern)
+    : pImpl(new impl(pattern))
+{
+}
+
+glob_pattern::glob_pattern(glob_pattern&& other) noexcept
+    : pImpl{ other.pImpl }
+{
+    other.pImpl = nullptr;
+}
+
+glob_pattern& glob_pattern::operator=(glob_pattern&& other) noexcept
+{
+    delete pImpl;
+    pImpl       = other.pImpl;
+    other.pImpl = nullptr;
+    return *this;
+}
+
+glob_pattern::~glob_pattern()
+{
+    delete pImpl;
+    pImpl = nullptr;
+}
+
+bool glob_pattern::is_valid() const
+{
+    return pImpl->is_valid;
 }
 
-std::u8string scanner::impl::get_directory_path(const directory* dir)
+bool glob_pattern::match(std::u8string_view path) const
 {
-    fs::path result;
-    for (directory* ptr0 = dir->parent; ptr0; ptr0 = ptr0->parent)
+    if (!pImpl->is_valid)
+        return false;
+    std::vector<std::uint32_t> states;
+    for (std::uint32_t start : pImpl->starts)
+    {
+        pImpl->add_state(states, start);
+    }
+    std::vector<std::uint32_t> next;
+    for (;;)
     {
-        result = ptr0->name / result;
+        const size_t             slash = path.find(u8'/');
+        const std::u8string_view name  = path.substr(0, slash);
+        if (slash == std::u8string_view::npos)
+            return pImpl->accept_file(states, name);
+        path.remove_prefix(slash + 1);
+        if (name.empty())
+            continue;
+        next.clear();
+        pImpl->advance(states, name, next);
+        if (next.empty())
+            return false;
+        states.swap(next);
     }
-    result /= dir->name;
-    return result.u8string();
 }
 
-std::u8string scanner::impl::get_file_path(const file* fl)
+// Depth first walk with set of active states for every directory. Sets
+// live in one pool: frame of popped directory is the top of the pool.
+std::vector<node_id> scanner::impl::find_glob(
+    const glob_pattern::impl& glob) const
 {
-    fs::path result;
-    for (directory* ptr0 = fl->parent; ptr0; ptr0 = ptr0->parent)
+    std::vector<node_id> result;
+    if (!glob.is_valid || folders.empty())
+        return result;
+
+    struct frame
+    {
+        node_id       dir   = root_node;
+        std::uint32_t first = 0; // in pool
+    };
+    std::vector<std::uint32_t> pool;
+    std::vector<frame>         stack{ frame{} };
+    for (std::uint32_t start : glob.starts)
+    {
+        glob.add_state(pool, start);
+    }
+
+    std::vector<std::uint32_t> states;
+    std::vector<std::uint32_t> next;
+    std::vector<node_id>       candidates;
+    while (!stack.empty())
     {
-        result = ptr0->name / result;
+        const frame f = stack.back();
+        stack.pop_back();
+        states.assign(pool.begin() + f.first, pool.end());
+        pool.resize(f.first);
+
+        // only literal names: look them up, do not read all children
+        const bool is_literal = std::ranges::all_of(
+            states,
+            [&](std::uint32_t state)
+            {
+                const auto kind = glob.components[state].kind;
+                return kind == glob_component::type::literal;
+            });
+
+        const directory& d = folders[f.dir];
+        if (is_literal)
+        {
+            // every directory is visited once, so duplicates can come
+            // only from files of this one
+            const auto frame_start = static_cast<std::ptrdiff_t>(result.size());
+            candidates.clear();
+            for (std::uint32_t state : states)
+            {
+                const std::u8string& name = glob.components[state].text;
+                if (glob.components[state + 1].kind ==
+                    glob_component::type::accept)
+                {
+                    const node_id id = find_child_file(f.dir, name);
+                    if (id != no_node &&
+                        std::find(result.begin() + frame_start,
+                                  result.end(),
+                                  id) == result.end())
+                        result.push_back(id);
+                }
+                else
+                {
+                    const node_id id = find_child_folder(f.dir, name);
+                    if (id != no_node &&
+                        std::ranges::find(candidates, id) == candidates.end())
+                        candidates.push_back(id);
+                }
+            }
+        }
+        else
+        {
+            for (node_id id = d.first_file; id < d.first_file + d.file_count;
+                 ++id)
+            {
+                if (glob.accept_file(states, get_name(files[id].name)))
+                    result.push_back(id);
+            }
+            candidates.resize(d.folder_count);
+            for (node_id i = 0; i < d.folder_count; ++i)
+                candidates[i] = d.first_folder + i;
+        }
+
+        // children are pushed in reverse order to be visited in order
+        for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+        {
+            next.clear();
+            glob.advance(states, get_name(folders[*it].name), next);
+            if (next.empty())
+                continue; // whole subtree is pruned
+            stack.push_back(
+                frame{ *it, static_cast<std::uint32_t>(pool.size()) });
+            pool.insert(pool.end(), next.begin(), next.end());
+        }
     }
-    result /= (fl->get_full_name());
-    return result.u8string();
+    return result;
 }
 
 scanner::scanner(std::u8string_view path_)
+    : scanner(path_, scanner_options{})
+{
+}
+
+scanner::scanner(std::u8string_view path_, const scanner_options& options)
     : pImpl(new scanner::impl)
 {
     fs::path path(path_);
@@ -258,9 +3077,23 @@ scanner::scanner(std::u8string_view path_)
         path = (fs::current_path() / path).u8string();
     }
     if (!fs::exists(path))
+    {
+        pImpl->loaded.set_value();
         return;
-    pImpl->root.name = path.u8string();
-    pImpl->scan();
+    }
+    pImpl->root_path     = path.u8string();
+    pImpl->backend       = options.backend;
+    pImpl->num_threads   = options.num_threads;
+    pImpl->hash_contents = options.hash_contents;
+    if (options.async)
+    {
+        pImpl->is_loading = true;
+        pImpl->loader     = std::thread([self = pImpl, options]
+                                    { self->build_async(options); });
+        return;
+    }
+    pImpl->build(options);
+    pImpl->loaded.set_value();
 }
 
 scanner::scanner(scanner&& scnr) noexcept
@@ -285,80 +3118,90 @@ scanner::~scanner()
 
 size_t scanner::get_file_size(std::u8string_view name) const
 {
-    size_t result = std::numeric_limits<size_t>::max();
-    file*  fl     = pImpl->find_file_ptr(name);
-    if (fl)
-        result = fl->size;
+    const auto lock = pImpl->read_lock();
+    size_t        result = std::numeric_limits<size_t>::max();
+    const node_id fl     = pImpl->find_file(name);
+    if (fl != no_node)
+        result = std::as_const(pImpl->files)[fl].size; // no copy of mapped
     return result;
 }
 
 bool scanner::is_file_exists(std::u8string_view path) const
 {
-    file* fl = pImpl->find_file_ptr(path);
-    return fl ? true : false;
+    const auto lock = pImpl->read_lock();
+    return pImpl->find_file(path) != no_node;
 }
 
 std::vector<file_info> scanner::get_files_with_extension(
     std::u8string_view path, std::u8string_view ext) const
 {
-    std::vector<file_info> result;
+    const auto lock = pImpl->read_lock();
     // if (ext.front() == '.')  was supposed for user request like ".cxx"
     // with dot forward
     //    ext.erase(0, 1);
-    directory* dir = pImpl->find_directory_ptr(path);
-    if (dir)
+    return pImpl->get_indexed_files(
+        pImpl->extensions, &impl::get_extension, path, ext, false);
+}
+
+std::vector<file_info> scanner::get_files_with_name(
+    std::u8string_view path, std::u8string_view name) const
+{
+    const auto lock = pImpl->read_lock();
+    if (name.empty())
     {
-        for (const auto& p : dir->child_files)
-        {
-            if (ext == p->extension)
-            {
-                file_info tmp;
-                tmp.size     = p->size;
-                tmp.abs_path = pImpl->get_file_path(p);
-                result.push_back(tmp);
-            }
-        }
+        return {};
     }
-    return result;
+    return pImpl->get_indexed_files(
+        pImpl->stems, &impl::get_stem, path, name, false);
 }
 
-std::vector<file_info> scanner::get_files_with_name(
+std::vector<file_info> scanner::find_files_with_extension(
+    std::u8string_view path, std::u8string_view ext) const
+{
+    const auto lock = pImpl->read_lock();
+    return pImpl->get_indexed_files(
+        pImpl->extensions, &impl::get_extension, path, ext, true);
+}
+
+std::vector<file_info> scanner::find_files_with_name(
     std::u8string_view path, std::u8string_view name) const
 {
-    std::vector<file_info> result;
+    const auto lock = pImpl->read_lock();
     if (name.empty())
     {
-        return result;
+        return {};
     }
-    directory* dir = pImpl->find_directory_ptr(path);
-    if (dir)
+    return pImpl->get_indexed_files(
+        pImpl->stems, &impl::get_stem, path, name, true);
+}
+
+std::vector<file_info> scanner::find_files(const glob_pattern& pattern) const
+{
+    const auto lock = pImpl->read_lock();
+    std::vector<file_info> result;
+    for (node_id id : pImpl->find_glob(*pattern.pImpl))
     {
-        for (const auto& p : dir->child_files)
-        {
-            if (name == p->name)
-            {
-                file_info tmp;
-                tmp.size     = p->size;
-                tmp.abs_path = pImpl->get_file_path(p);
-                result.push_back(tmp);
-            }
-        }
+        result.push_back(
+            pImpl->get_file_info(std::as_const(pImpl->files)[id]));
     }
     return result;
 }
 
+std::vector<file_info> scanner::find_files(std::u8string_view pattern) const
+{
+    return find_files(glob_pattern(pattern));
+}
+
 std::vector<file_info> scanner::get_files(std::u8string_view path) const
 {
+    const auto lock = pImpl->read_lock();
     std::vector<file_info> result;
-    directory*             dir = pImpl->find_directory_ptr(path);
-    if (dir)
+    const node_id          dir = pImpl->find_directory(path);
+    if (dir != no_node)
     {
-        for (const auto& p : dir->child_files)
+        for (const file& p : pImpl->get_child_files(dir))
         {
-            file_info tmp;
-            tmp.size     = p->size;
-            tmp.abs_path = pImpl->get_file_path(p);
-            result.push_back(tmp);
+            result.push_back(pImpl->get_file_info(p));
         }
     }
     return result;
@@ -366,24 +3209,195 @@ std::vector<file_info> scanner::get_files(std::u8string_view path) const
 
 std::vector<file_info> scanner::get_all_files() const
 {
+    const auto lock = pImpl->read_lock();
     std::vector<file_info> result;
-    for (const auto& p : pImpl->files)
+    for (const file& p : pImpl->files)
+    {
+        if (p.parent != dead_node)
+            result.push_back(pImpl->get_file_info(p));
+    }
+    return result;
+}
+
+file_range scanner::get_file_refs(std::u8string_view path) const
+{
+    const node_id dir =
+        pImpl->is_loading ? no_node : pImpl->find_directory(path);
+    if (dir == no_node)
+        return file_range(this, 0, 0);
+    const directory& d = std::as_const(pImpl->folders)[dir];
+    return file_range(this, d.first_file, d.first_file + d.file_count);
+}
+
+file_range scanner::get_all_file_refs() const
+{
+    if (pImpl->is_loading)
+        return file_range(this, 0, 0);
+    return file_range(this, 0, static_cast<node_id>(pImpl->files.size()));
+}
+
+size_t file_ref::size() const
+{
+    const scanner::impl& self = *owner->pImpl;
+    return self.files[id].size;
+}
+
+std::u8string_view file_ref::name() const
+{
+    const scanner::impl& self = *owner->pImpl;
+    return self.get_name(self.files[id].name);
+}
+
+std::u8string_view file_ref::stem() const
+{
+    const scanner::impl& self = *owner->pImpl;
+    return self.get_stem(self.files[id]);
+}
+
+std::u8string_view file_ref::extension() const
+{
+    const scanner::impl& self = *owner->pImpl;
+    return self.get_extension(self.files[id]);
+}
+
+content_hash file_ref::hash() const
+{
+    const scanner::impl& self = *owner->pImpl;
+    const file_content*  content =
+        self.hash_contents ? self.find_content(self.files[id]) : nullptr;
+    return content != nullptr ? content->hash : content_hash{};
+}
+
+std::u8string_view file_ref::path(std::u8string& buffer) const
+{
+    const scanner::impl& self = *owner->pImpl;
+    const file&          fl   = self.files[id];
+    buffer.clear();
+    self.append_relative_path(fl.parent, fl.name, buffer);
+    return buffer;
+}
+
+std::u8string_view file_ref::abs_path(std::u8string& buffer) const
+{
+    const scanner::impl& self = *owner->pImpl;
+    const file&          fl   = self.files[id];
+    buffer.clear();
+    self.append_absolute_path(fl.parent, fl.name, buffer);
+    return buffer;
+}
+
+file_range::file_range(const scanner* owner_,
+                       std::uint32_t  first_,
+                       std::uint32_t  last_)
+    : owner{ owner_ }
+    , first{ owner_->pImpl->skip_dead_files(first_, last_) }
+    , last{ last_ }
+{
+}
+
+file_range::iterator& file_range::iterator::operator++()
+{
+    id = owner->pImpl->skip_dead_files(id + 1, last);
+    return *this;
+}
+
+content_hash scanner::get_file_hash(std::u8string_view path) const
+{
+    const auto lock = pImpl->read_lock();
+    const node_id id = pImpl->find_file(path);
+    if (id == no_node || !pImpl->hash_contents)
+        return {};
+    const file_content* content =
+        pImpl->find_content(std::as_const(pImpl->files)[id]);
+    return content != nullptr ? content->hash : content_hash{};
+}
+
+std::vector<std::vector<file_info>> scanner::find_duplicates() const
+{
+    const auto lock = pImpl->read_lock();
+    struct candidate
+    {
+        content_hash hash;
+        size_t       size = 0;
+        node_id      id   = 0;
+    };
+    std::vector<candidate> candidates;
+    if (pImpl->hash_contents)
+    {
+        const std::span<const file> nodes = pImpl->files.view();
+        for (node_id id = 0; id < nodes.size(); ++id)
+        {
+            const file_content* content = pImpl->find_content(nodes[id]);
+            if (nodes[id].parent != dead_node && content != nullptr &&
+                content->size != 0)
+                candidates.push_back({ content->hash, content->size, id });
+        }
+    }
+    auto key = [](const candidate& c)
+    { return std::tuple(c.hash.low, c.hash.high, c.size); };
+    std::ranges::sort(candidates, {}, key);
+
+    std::vector<std::vector<file_info>> result;
+    for (auto first = candidates.begin(); first != candidates.end();)
     {
-        file_info tmp;
-        tmp.size     = p->size;
-        tmp.abs_path = pImpl->get_file_path(p);
-        result.push_back(tmp);
+        auto last = std::find_if(first + 1,
+                                 candidates.end(),
+                                 [&](const candidate& c)
+                                 { return key(c) != key(*first); });
+        if (last - first > 1)
+        {
+            std::vector<file_info>& group = result.emplace_back();
+            for (auto it = first; it != last; ++it)
+                group.push_back(
+                    pImpl->get_file_info(std::as_const(pImpl->files)[it->id]));
+        }
+        first = last;
     }
     return result;
 }
 
+std::vector<file_change> scanner::poll_changes()
+{
+    std::vector<file_change> result;
+    if (pImpl->is_loading)
+        return result; // watch starts after background scan
+    if (pImpl->watch_fd >= 0)
+        pImpl->read_events(result);
+    if (!result.empty())
+        pImpl->build_file_index();
+    if (!result.empty() && pImpl->hash_contents)
+        pImpl->update_contents(result);
+    return result;
+}
+
+scan_progress scanner::get_progress() const
+{
+    scan_progress result;
+    result.folders = pImpl->visited_folders.load(std::memory_order_relaxed);
+    result.files   = pImpl->visited_files.load(std::memory_order_relaxed);
+    result.done    = !pImpl->is_loading;
+    return result;
+}
+
+std::shared_future<void> scanner::get_future() const
+{
+    return pImpl->loaded_future;
+}
+
 scanner_report scanner::get_report() const
 {
+    const auto lock = pImpl->read_lock();
     scanner_report result;
     result.scan_time     = static_cast<size_t>(pImpl->scan_time.count());
     result.initialized   = pImpl->is_initialized;
     result.total_files   = pImpl->total_files;
     result.total_folders = pImpl->total_folders;
+    result.threads       = pImpl->threads;
+    result.watching      = pImpl->watch_fd >= 0;
+    result.from_snapshot   = pImpl->from_snapshot;
+    result.updated_folders = pImpl->updated_folders;
+    result.hashed_files    = pImpl->hashed_files;
+    result.hash_time       = static_cast<size_t>(pImpl->hash_time.count());
     return result;
 }
 
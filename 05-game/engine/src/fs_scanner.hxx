@@ -6,25 +6,224 @@
 #define SCNR_EXP
 #endif
 
+#include <cstddef>
+#include <cstdint>
+#include <future>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace om
 {
 
+// 128 bit non-cryptographic hash of file content
+struct content_hash
+{
+    std::uint64_t low  = 0;
+    std::uint64_t high = 0;
+
+    friend bool operator==(const content_hash&, const content_hash&) = default;
+};
+
 struct file_info
 {
     std::u8string abs_path;
     size_t        size = 0;
+    content_hash  hash{}; // zero if scanner does not hash contents
+};
+
+class scanner;
+
+// Lightweight handle of file in scanner tree, it is valid while scanner
+// is alive and not changed by poll_changes. Names are views of scanner
+// memory, paths are built only on request into caller's buffer.
+class SCNR_EXP file_ref
+{
+public:
+    [[nodiscard]] size_t             size() const;
+    [[nodiscard]] std::u8string_view name() const; // with extension
+    [[nodiscard]] std::u8string_view stem() const;
+    [[nodiscard]] std::u8string_view extension() const;
+    [[nodiscard]] content_hash       hash() const;
+
+    std::u8string_view path(std::u8string& buffer) const;
+    std::u8string_view abs_path(std::u8string& buffer) const;
+
+    // Functions write relative ('/' separated) or absolute path to the
+    // buffer and return view of it. Buffer memory is reused, so one
+    // buffer for whole enumeration does not allocate for every file.
+
+private:
+    friend class file_range;
+    file_ref(const scanner* owner_, std::uint32_t id_)
+        : owner{ owner_ }
+        , id{ id_ }
+    {
+    }
+
+    const scanner* owner = nullptr;
+    std::uint32_t  id    = 0;
+};
+
+class SCNR_EXP file_range
+{
+public:
+    class SCNR_EXP iterator
+    {
+    public:
+        using value_type      = file_ref;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        file_ref  operator*() const { return file_ref(owner, id); }
+        iterator& operator++();
+        iterator  operator++(int)
+        {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator==(const iterator& other) const { return id == other.id; }
+
+    private:
+        friend class file_range;
+        iterator(const scanner* owner_, std::uint32_t id_, std::uint32_t last_)
+            : owner{ owner_ }
+            , id{ id_ }
+            , last{ last_ }
+        {
+        }
+
+        const scanner* owner = nullptr;
+        std::uint32_t  id    = 0;
+        std::uint32_t  last  = 0;
+    };
+
+    [[nodiscard]] iterator begin() const { return { owner, first, last }; }
+    [[nodiscard]] iterator end() const { return { owner, last, last }; }
+    [[nodiscard]] bool     empty() const { return first == last; }
+
+private:
+    friend class scanner;
+    file_range(const scanner* owner_,
+               std::uint32_t  first_,
+               std::uint32_t  last_);
+
+    const scanner* owner = nullptr;
+    std::uint32_t  first = 0;
+    std::uint32_t  last  = 0;
+};
+
+enum class scan_backend
+{
+    std_filesystem, // std::filesystem::directory_iterator, portable
+    getdents        // linux getdents64, stat only for file sizes
+};
+
+struct scanner_options
+{
+    size_t num_threads = 1;
+    // Number of worker threads used to walk the tree. Workers share
+    // directories through work-stealing queues. Zero means
+    // std::thread::hardware_concurrency().
+    bool watch = false;
+    // Keep tree up to date with file system changes (inotify, linux
+    // only). Changes are applied and returned by scanner::poll_changes.
+    std::u8string snapshot;
+    // File, where tree is kept between launches. If it was made for the
+    // same root, tree is mapped from it and only directories with new
+    // mtime are read again, then file is updated. Note: file modified
+    // in place does not change directory mtime, so its size can be old.
+    scan_backend backend = scan_backend::std_filesystem;
+    // How directories are read. getdents needs less system calls and
+    // memory allocations, it is std_filesystem on other platforms.
+    bool hash_contents = false;
+    // Compute content hash of every file on num_threads threads. File
+    // is read again only if its size or mtime changed since previous
+    // hashing, with snapshot option hashes are stored in snapshot.
+    bool async = false;
+    // Constructor returns at once, tree is scanned on background thread.
+    // Queries see directories scanned so far, every directory is seen
+    // with all its entries or as empty one. File refs, hashes and
+    // changes are available after scanner::get_future() is ready.
+};
+
+struct scan_progress
+{
+    size_t folders = 0; // read so far, root included
+    size_t files   = 0;
+    bool   done    = false;
+};
+
+struct file_change
+{
+    enum class type
+    {
+        created,
+        modified,
+        removed,
+        rescanned // events were lost, tree was rebuilt, path is empty
+    };
+
+    std::u8string path; // relative to scanner root, '/' separated
+    type          what = type::modified;
+};
+
+struct thread_report
+{
+    size_t scan_time     = 0;
+    size_t total_files   = 0;
+    size_t total_folders = 0;
+    size_t steals        = 0;
 };
 
 struct scanner_report
 {
-    size_t    scan_time     = 0;
-    size_t    total_files   = 0;
-    size_t    total_folders = 0;
-    bool      initialized   = false;
-    std::byte padding[7]    = {};
+    size_t                     scan_time     = 0;
+    size_t                     total_files   = 0;
+    size_t                     total_folders = 0;
+    size_t                     updated_folders = 0; // after snapshot
+    size_t                     hashed_files    = 0; // read, not reused
+    size_t                     hash_time       = 0;
+    std::vector<thread_report> threads{};
+    bool                       initialized   = false;
+    bool                       watching      = false;
+    bool                       from_snapshot = false;
+    std::byte                  padding[5]    = {};
+};
+
+class SCNR_EXP glob_pattern final
+{
+public:
+    glob_pattern()                    = delete;
+    glob_pattern(const glob_pattern&) = delete;
+    glob_pattern& operator=(const glob_pattern&) = delete;
+
+    glob_pattern(glob_pattern&&) noexcept;
+    glob_pattern& operator=(glob_pattern&&) noexcept;
+
+    explicit glob_pattern(std::u8string_view pattern);
+
+    // Pattern is compiled once and can be used with any scanner.
+    // Path relative to scanner root, '/' separated. Supported: '*' and
+    // '?' inside one name, "[a-z]" and "[!a-z]" byte classes, "{a,b}"
+    // alternatives (may contain '/') and "**" for any number of
+    // directories: "res/**/level_??.txt", "*.{png,wav}".
+
+    [[nodiscard]] bool is_valid() const;
+    [[nodiscard]] bool match(std::u8string_view path) const;
+
+    // Function returns false for unbalanced '[' or '{' or empty
+    // pattern. Invalid pattern matches nothing.
+
+    ~glob_pattern();
+
+private:
+    friend class scanner;
+
+    class impl;
+    impl* pImpl;
 };
 
 class SCNR_EXP scanner final
@@ -38,6 +237,11 @@ public:
     scanner& operator=(scanner&&) noexcept;
 
     explicit scanner(std::u8string_view path);
+    scanner(std::u8string_view path, const scanner_options& options);
+
+    // Scan is done in constructor. With options.num_threads > 1
+    // directories are processed in parallel, every worker builds its
+    // own part of the tree, parts are merged after all workers finish.
 
     [[nodiscard]] size_t get_file_size(std::u8string_view name) const;
 
@@ -71,6 +275,26 @@ public:
     // root directory.  Empty name is an incorrect value.
     // Incorrect parameters will return an empty container.
 
+    [[nodiscard]] std::vector<file_info> find_files_with_extension(
+        std::u8string_view path, std::u8string_view ext) const;
+    [[nodiscard]] std::vector<file_info> find_files_with_name(
+        std::u8string_view path, std::u8string_view name) const;
+
+    // Recursive versions of two functions above: files of the path
+    // directory and all its subdirectories. Answer is taken from
+    // extension and name indexes, which are built with the tree, so
+    // time depends on size of the result, not on size of the tree.
+
+    [[nodiscard]] std::vector<file_info> find_files(
+        const glob_pattern& pattern) const;
+    [[nodiscard]] std::vector<file_info> find_files(
+        std::u8string_view pattern) const;
+
+    // Function returns files, which relative paths match glob pattern.
+    // Directories, that can not match, are skipped with all children,
+    // literal names are found without reading the directory. Compile
+    // pattern once with glob_pattern if query is repeated.
+
     [[nodiscard]] std::vector<file_info> get_files(std::u8string_view path) const;
 
     // Function return a file_list container, which holds file_info
@@ -84,6 +308,40 @@ public:
     // Function return a file_list container, which holds file_info
     // structure for all files that scanner found in all directories.
 
+    [[nodiscard]] file_range get_file_refs(std::u8string_view path) const;
+    [[nodiscard]] file_range get_all_file_refs() const;
+
+    // Same as get_files and get_all_files, but nothing is copied: range
+    // of handles is returned, path is built only if it is asked.
+    // Enumeration of the whole tree does not allocate memory.
+
+    [[nodiscard]] content_hash get_file_hash(std::u8string_view path) const;
+
+    // Function returns content hash of file, zero if file does not
+    // exist or scanner was created without hash_contents option.
+
+    [[nodiscard]] std::vector<std::vector<file_info>> find_duplicates() const;
+
+    // Function returns groups of files with equal size and content
+    // hash, every group has two or more files. Empty files are not
+    // reported. List is empty without hash_contents option.
+
+    [[nodiscard]] std::vector<file_change> poll_changes();
+
+    // Function reads file system events collected since previous call,
+    // applies them to scanner tree and returns list of changed files.
+    // Never blocks. Returns empty list if scanner was created without
+    // watch option. Call it on the same thread with other requests.
+    // Content hashes of created and modified files are updated too.
+
+    [[nodiscard]] scan_progress            get_progress() const;
+    [[nodiscard]] std::shared_future<void> get_future() const;
+
+    // Progress of scan started with async option and future, which is
+    // ready when scan is finished. Future holds exception of failed
+    // scan. For scanner created without async option future is ready
+    // and progress is done right after constructor.
+
     [[nodiscard]] scanner_report get_report() const;
 
     // Function return a scanner_report structure, which contains
@@ -92,6 +350,9 @@ public:
     ~scanner();
 
 private:
+    friend class file_ref;
+    friend class file_range;
+
     class impl;
     impl* pImpl;
 };
@@ -0,0 +1,555 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "fs_scanner.hxx"
+#include "om/metrics.hxx"
+
+// Usage: scanner_benchmark [--depth N] [--fan-out N] [--files N]
+//                          [--name-length N] [--seed N] [--lookups N]
+//                          [--output results.json]
+//                          [--baseline old.json] [--tolerance percent]
+//
+// Tree is generated from the seed, so two runs with the same options
+// scan the same names. With --baseline every metric is compared with
+// previous results, exit code is not zero if any of them is worse
+// than tolerance allows or if size of the work ("count": files,
+// matches) is not the same.
+
+namespace fs = std::filesystem;
+
+// Every allocation of the process, scanner library included. Not
+// inlined: gcc takes free() of inlined delete for mismatched call.
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct tree_params
+{
+    size_t   depth         = 3;
+    size_t   fan_out       = 8;
+    size_t   files_per_dir = 32;
+    size_t   name_length   = 12; // without extension
+    unsigned seed          = 42;
+};
+
+// "<index>_<random letters>", index keeps names unique
+static std::string make_name(size_t index, size_t length, std::mt19937& random)
+{
+    std::string name = std::to_string(index) + '_';
+    while (name.size() < length)
+        name += static_cast<char>('a' + random() % 26);
+    return name;
+}
+
+// Generate tree and return relative paths of all created files
+static std::vector<std::u8string> generate_tree(const fs::path&    root,
+                                                const tree_params& params)
+{
+    static const char* const extensions[] = { ".png", ".wav", ".txt",
+                                              ".json" };
+
+    std::mt19937               random(params.seed);
+    std::vector<std::u8string> result;
+    std::vector<fs::path>      level{ fs::path() };
+    for (size_t depth = 0; depth <= params.depth; ++depth)
+    {
+        std::vector<fs::path> next_level;
+        for (const fs::path& dir : level)
+        {
+            fs::create_directories(root / dir);
+            for (size_t i = 0; i < params.files_per_dir; ++i)
+            {
+                fs::path file =
+                    dir / (make_name(i, params.name_length, random) +
+                           extensions[random() % std::size(extensions)]);
+                std::ofstream(root / file) << std::string(random() % 256, 'x');
+                result.push_back(file.generic_u8string());
+            }
+            if (depth == params.depth)
+                continue;
+            for (size_t i = 0; i < params.fan_out; ++i)
+            {
+                next_level.push_back(dir /
+                                     make_name(i, params.name_length, random));
+            }
+        }
+        level = std::move(next_level);
+    }
+    return result;
+}
+
+// Number of system calls made by func() in forked child process under
+// ptrace, or -1 if tracing is not allowed
+template <typename Func>
+static long count_syscalls(Func func)
+{
+#if defined(__linux__)
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+            _exit(EXIT_FAILURE);
+        raise(SIGSTOP);
+        func();
+        _exit(EXIT_SUCCESS);
+    }
+    int status = 0;
+    if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status))
+        return -1;
+    ptrace(PTRACE_SETOPTIONS, child, nullptr, PTRACE_O_TRACESYSGOOD);
+
+    long stops  = 0; // on enter and on exit of every system call
+    int  signal = 0;
+    while (ptrace(PTRACE_SYSCALL, child, nullptr, signal) == 0 &&
+           waitpid(child, &status, 0) == child && WIFSTOPPED(status))
+    {
+        signal = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+            ++stops;
+        else
+            signal = WSTOPSIG(status);
+    }
+    return stops / 2;
+#else
+    (void)func;
+    return -1;
+#endif
+}
+
+// Peak resident set size of the process in kilobytes, 0 if unknown
+static double get_peak_rss_kb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss) / 1024.0; // in bytes
+#else
+    return static_cast<double>(usage.ru_maxrss);
+#endif
+#else
+    return 0.0;
+#endif
+}
+
+template <typename Func>
+static double measure_ns(size_t count, Func func)
+{
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    func();
+    const auto finish = steady_clock::now();
+    return static_cast<double>(
+               duration_cast<nanoseconds>(finish - start).count()) /
+           static_cast<double>(count);
+}
+
+// Every call is timed alone, so clock overhead (~20 ns) is included
+template <typename Func>
+static std::vector<double> measure_each_ns(size_t count, Func func)
+{
+    std::vector<double> samples(count);
+    for (size_t i = 0; i < count; ++i)
+        samples[i] = measure_ns(1, [&] { func(i); });
+    std::ranges::sort(samples);
+    return samples;
+}
+
+static double get_percentile(const std::vector<double>& sorted, double p)
+{
+    const auto index =
+        static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+// What one writes without glob support, for patterns used below
+static std::string glob_to_regex(std::string_view glob)
+{
+    std::string result;
+    for (size_t i = 0; i < glob.size(); ++i)
+    {
+        if (glob.substr(i, 3) == "**/")
+        {
+            result += "(.*/)?";
+            i += 2;
+        }
+        else if (glob[i] == '*')
+            result += "[^/]*";
+        else if (glob[i] == '?')
+            result += "[^/]";
+        else if (glob[i] == '.')
+            result += "\\.";
+        else if (glob[i] == '{')
+            result += '(';
+        else if (glob[i] == '}')
+            result += ')';
+        else if (glob[i] == ',')
+            result += '|';
+        else
+            result += glob[i];
+    }
+    return result;
+}
+
+using om::metric;
+
+class results
+{
+public:
+    void add(std::string name, double value, std::string unit)
+    {
+        std::cout << name << ": " << value << ' ' << unit << '\n';
+        list.push_back(metric{ std::move(name), value, std::move(unit) });
+    }
+
+    bool write(const fs::path& path, const tree_params& params) const
+    {
+        std::ofstream out(path);
+        out.precision(15); // counts are compared exactly, not 1.23457e+06
+        out << "{\n"
+            << "  \"params\": {\"depth\": " << params.depth
+            << ", \"fan_out\": " << params.fan_out
+            << ", \"files_per_dir\": " << params.files_per_dir
+            << ", \"name_length\": " << params.name_length
+            << ", \"seed\": " << params.seed << "},\n"
+            << "  \"metrics\": [\n";
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            out << "    {\"name\": \"" << list[i].name
+                << "\", \"value\": " << list[i].value << ", \"unit\": \""
+                << list[i].unit << "\"}"
+                << (i + 1 == list.size() ? "\n" : ",\n");
+        }
+        out << "  ]\n}\n";
+        return out.good();
+    }
+
+    // number of metrics worse than in file written by write() by more
+    // than tolerance
+    size_t compare(const fs::path& path, double tolerance) const
+    {
+        return om::compare_metrics(list, path, tolerance);
+    }
+
+private:
+    std::vector<metric> list;
+};
+
+int main(int argc, char* argv[])
+{
+    tree_params params;
+    size_t      lookups   = 100'000;
+    double      tolerance = 20.0; // percent
+    fs::path    output;
+    fs::path    baseline;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string_view key   = argv[i];
+        const char*            value = argv[i + 1];
+        if (key == "--depth")
+            params.depth = std::strtoul(value, nullptr, 10);
+        else if (key == "--fan-out")
+            params.fan_out = std::strtoul(value, nullptr, 10);
+        else if (key == "--files")
+            params.files_per_dir = std::strtoul(value, nullptr, 10);
+        else if (key == "--name-length")
+            params.name_length = std::strtoul(value, nullptr, 10);
+        else if (key == "--seed")
+            params.seed =
+                static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        else if (key == "--lookups")
+            lookups = std::strtoul(value, nullptr, 10);
+        else if (key == "--output")
+            output = value;
+        else if (key == "--baseline")
+            baseline = value;
+        else if (key == "--tolerance")
+            tolerance = std::strtod(value, nullptr);
+        else
+            argc = 0; // unknown option
+    }
+    if (argc % 2 == 0 || lookups == 0 || params.files_per_dir == 0)
+    {
+        std::cerr << "usage: scanner_benchmark [--option value]...\n"
+                     "options: --depth --fan-out --files --name-length "
+                     "--seed --lookups --output --baseline --tolerance\n";
+        return EXIT_FAILURE;
+    }
+
+    const fs::path root = fs::temp_directory_path() / "om_scanner_benchmark";
+    fs::remove_all(root);
+    const std::vector<std::u8string> paths = generate_tree(root, params);
+
+    results result;
+
+    // first scan of the tree, memory of the scanner itself
+    const double rss_before = get_peak_rss_kb();
+    om::scanner  scanner(root.u8string());
+    const double rss_after = get_peak_rss_kb();
+
+    const om::scanner_report report = scanner.get_report();
+    result.add("tree.files", static_cast<double>(report.total_files), "count");
+    result.add("tree.folders", static_cast<double>(report.total_folders),
+               "count");
+    result.add("scan.first", static_cast<double>(report.scan_time), "ms");
+    result.add("scan.peak_rss_growth", rss_after - rss_before, "kb");
+
+    // A/B of directory reading backends on the same tree
+    std::vector<size_t> thread_counts{ 1 };
+    if (std::thread::hardware_concurrency() > 1)
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    for (auto backend :
+         { om::scan_backend::std_filesystem, om::scan_backend::getdents })
+    {
+        for (size_t threads : thread_counts)
+        {
+            om::scanner_options options;
+            options.backend     = backend;
+            options.num_threads = threads;
+            auto scan = [&] { om::scanner tree(root.u8string(), options); };
+
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < 5; ++i)
+                best = std::min(best, measure_ns(1'000'000, scan));
+
+            const std::string name =
+                std::string("scan.") +
+                (backend == om::scan_backend::getdents ? "getdents"
+                                                       : "std_filesystem") +
+                ".threads_" + std::to_string(threads);
+            result.add(name, best, "ms");
+            if (threads != 1)
+                continue; // the same work, only timing differs
+
+            const size_t allocated = allocations.load();
+            scan();
+            result.add(name + ".allocations",
+                       static_cast<double>(allocations.load() - allocated),
+                       "calls");
+            const long syscalls = count_syscalls(scan);
+            if (syscalls >= 0)
+                result.add(name + ".syscalls", static_cast<double>(syscalls),
+                           "calls");
+        }
+    }
+
+    // content hashing of every file on all hardware threads
+    om::scanner_options hashing;
+    hashing.hash_contents = true;
+    hashing.num_threads   = 0;
+    const om::scanner hashed(root.u8string(), hashing);
+    result.add("hash.all_files",
+               static_cast<double>(hashed.get_report().hash_time), "ms");
+    size_t groups = 0;
+    result.add("hash.find_duplicates",
+               measure_ns(1'000'000,
+                          [&] { groups = hashed.find_duplicates().size(); }),
+               "ms");
+
+    // latency of single lookups
+    std::mt19937               random(params.seed);
+    std::vector<std::u8string> requests;
+    std::vector<std::u8string> misses;
+    requests.reserve(lookups);
+    misses.reserve(lookups);
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        const std::u8string& path = paths[random() % paths.size()];
+        requests.push_back(path);
+        misses.push_back(path + u8".bak");
+    }
+
+    size_t found = 0;
+    size_t bytes = 0;
+
+    const auto hits = measure_each_ns(
+        lookups,
+        [&](size_t i) { found += scanner.is_file_exists(requests[i]); });
+    const auto sizes = measure_each_ns(
+        lookups,
+        [&](size_t i) { bytes += scanner.get_file_size(requests[i]); });
+    const auto missed = measure_each_ns(
+        lookups, [&](size_t i) { found += scanner.is_file_exists(misses[i]); });
+
+    for (const auto& [name, samples] :
+         { std::pair{ "lookup.exists_hit", &hits },
+           std::pair{ "lookup.file_size_hit", &sizes },
+           std::pair{ "lookup.exists_miss", &missed } })
+    {
+        for (int p : { 50, 90, 99 })
+            result.add(std::string(name) + ".p" + std::to_string(p),
+                       get_percentile(*samples, p), "ns");
+    }
+
+    const size_t allocated = allocations.load();
+    for (const auto& path : requests)
+        bytes += scanner.get_file_size(path);
+    result.add("lookup.allocations",
+               static_cast<double>(allocations.load() - allocated), "calls");
+
+    // throughput of queries
+    size_t chars    = 0;
+    size_t returned = 0;
+
+    auto files_per_second = [&](auto func)
+    { return 1e9 / measure_ns(report.total_files, func); };
+
+    result.add("query.get_all_files",
+               files_per_second(
+                   [&]
+                   {
+                       for (const auto& info : scanner.get_all_files())
+                           chars += info.abs_path.size();
+                   }),
+               "files/s");
+    result.add("query.get_all_file_refs",
+               files_per_second(
+                   [&]
+                   {
+                       std::u8string buffer; // the only allocation
+                       for (om::file_ref file : scanner.get_all_file_refs())
+                           chars += file.abs_path(buffer).size();
+                   }),
+               "files/s");
+
+    std::vector<std::u8string> folders;
+    for (size_t i = 0; i < 1'000; ++i)
+    {
+        const std::u8string& path = paths[random() % paths.size()];
+        const size_t         end  = path.rfind(u8'/');
+        folders.emplace_back(end == std::u8string::npos ? u8""
+                                                        : path.substr(0, end));
+    }
+    auto queries_per_second = [&](auto func)
+    {
+        return 1e9 / measure_ns(folders.size(),
+                                [&]
+                                {
+                                    for (const auto& folder : folders)
+                                        returned += func(folder).size();
+                                });
+    };
+
+    result.add("query.get_files_with_extension",
+               queries_per_second(
+                   [&](const std::u8string& folder) {
+                       return scanner.get_files_with_extension(folder, u8"png");
+                   }),
+               "queries/s");
+    result.add("query.find_files_with_extension",
+               queries_per_second(
+                   [&](const std::u8string& folder) {
+                       return scanner.find_files_with_extension(folder,
+                                                                u8"wav");
+                   }),
+               "queries/s");
+
+    // glob query against filtering of the whole tree: files of one
+    // branch and files of every directory at one level
+    for (const auto& [name, text] :
+         { std::pair{ "branch", u8"1_*/**/1?_*.png" },
+           std::pair{ "level", u8"*/*/2_*/[0-3]_*.{png,wav}" } })
+    {
+        const std::string      narrow(reinterpret_cast<const char*>(text));
+        const om::glob_pattern pattern(text);
+        const std::regex       regex(glob_to_regex(narrow));
+        const size_t           prefix = root.u8string().size() + 1;
+
+        size_t matched[3] = {};
+        auto   by_regex   = [&]
+        {
+            for (const auto& info : scanner.get_all_files())
+            {
+                const std::u8string path = info.abs_path.substr(prefix);
+                matched[0] += std::regex_match(
+                    reinterpret_cast<const char*>(path.data()),
+                    reinterpret_cast<const char*>(path.data() + path.size()),
+                    regex);
+            }
+        };
+        auto by_match = [&]
+        {
+            std::u8string buffer;
+            for (om::file_ref file : scanner.get_all_file_refs())
+                matched[1] += pattern.match(file.path(buffer));
+        };
+        auto by_glob = [&]
+        { matched[2] += scanner.find_files(pattern).size(); };
+
+        const std::string key = std::string("glob.") + name;
+        result.add(key + ".regex", measure_ns(1'000'000, by_regex), "ms");
+        result.add(key + ".match", measure_ns(1'000'000, by_match), "ms");
+        result.add(key + ".find_files", measure_ns(1'000'000, by_glob), "ms");
+        result.add(key + ".matched", static_cast<double>(matched[2]), "count");
+        if (matched[0] != matched[2] || matched[1] != matched[2])
+        {
+            std::cerr << "glob and regex results differ: " << narrow << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    result.add("process.peak_rss", get_peak_rss_kb(), "kb");
+    std::cout << "(found " << found << ", bytes " << bytes << ", chars "
+              << chars << ", returned " << returned << ")\n";
+    fs::remove_all(root);
+
+    if (found != lookups)
+        return EXIT_FAILURE;
+    if (!output.empty() && !result.write(output, params))
+    {
+        std::cerr << "can not write " << output << '\n';
+        return EXIT_FAILURE;
+    }
+    try
+    {
+        if (!baseline.empty() && result.compare(baseline, tolerance) != 0)
+            return EXIT_FAILURE;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <clocale>
 #include <filesystem>
 #include <fstream>
@@ -95,6 +96,348 @@ TEST_CASE("scanner test")
                  forth_scanner_report.total_files) == counter);
     }
 
+    SECTION("multi-threaded scanner test")
+    {
+        om::scanner_options options;
+        options.num_threads = 4;
+
+        om::scanner        scanner(u8"test-folder", options);
+        om::scanner_report report = scanner.get_report();
+
+        REQUIRE(report.initialized == true);
+        REQUIRE(report.total_files == 10);
+        REQUIRE(report.total_folders == 8);
+        REQUIRE(report.threads.size() == 4);
+
+        size_t files   = 0;
+        size_t folders = 0;
+        for (const auto& thread : report.threads)
+        {
+            files += thread.total_files;
+            folders += thread.total_folders;
+        }
+        REQUIRE(files == 10);
+        REQUIRE(folders == 8);
+
+        REQUIRE(scanner.get_file_size(u8"game/game.cxx") == 47);
+        REQUIRE(scanner.get_file_size(u8"русский/файл") == 94);
+        REQUIRE(scanner.get_files(u8"engine/src").size() == 4);
+        REQUIRE(scanner.get_all_files().size() == 10);
+    }
+
+    SECTION("getdents backend test")
+    {
+        om::scanner_options options;
+        options.backend     = om::scan_backend::getdents;
+        options.num_threads = 2;
+
+        om::scanner        scanner(u8"test-folder", options);
+        om::scanner_report report = scanner.get_report();
+
+        REQUIRE(report.initialized == true);
+        REQUIRE(report.total_files == 10);
+        REQUIRE(report.total_folders == 8);
+        REQUIRE(scanner.get_file_size(u8"русский/файл") == 94);
+        REQUIRE(scanner.get_file_size(
+                    u8"engine/src/scanner/~.scanner/.gitignore") == 295);
+        REQUIRE(scanner.get_files_with_extension(u8"engine/src", u8"cxx")
+                    .size() == 2);
+
+        auto sorted_files = [](std::vector<om::file_info> files)
+        {
+            std::ranges::sort(files, {}, &om::file_info::abs_path);
+            return files;
+        };
+        const auto expected =
+            sorted_files(om::scanner(u8"test-folder").get_all_files());
+        const auto actual   = sorted_files(scanner.get_all_files());
+        REQUIRE(expected.size() == actual.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            REQUIRE(expected[i].abs_path == actual[i].abs_path);
+            REQUIRE(expected[i].size == actual[i].size);
+        }
+    }
+
+    SECTION("not existing root test")
+    {
+        om::scanner scanner(u8"test-folder/no_dir");
+
+        REQUIRE(scanner.get_report().initialized == false);
+        REQUIRE(scanner.get_files(u8"").empty());
+        REQUIRE(scanner.get_all_files().empty());
+        REQUIRE(scanner.is_file_exists(u8"appveyor.yml") == false);
+    }
+
+    SECTION("file_ref test")
+    {
+        om::scanner scanner(u8"test-folder");
+
+        std::u8string buffer;
+        size_t        count = 0;
+        size_t        bytes = 0;
+        for (om::file_ref file : scanner.get_file_refs(u8"engine/src"))
+        {
+            ++count;
+            bytes += file.size();
+            REQUIRE(file.path(buffer).starts_with(u8"engine/src/"));
+            REQUIRE(file.path(buffer).ends_with(file.name()));
+        }
+        REQUIRE(count == 4);
+        REQUIRE(bytes == 64);
+
+        size_t sources = 0;
+        for (om::file_ref file : scanner.get_all_file_refs())
+        {
+            if (file.extension() == u8"cxx")
+            {
+                ++sources;
+            }
+            if (file.name() == u8"c++")
+            {
+                REQUIRE(file.stem() == u8"c++");
+                REQUIRE(file.extension().empty());
+                REQUIRE(file.path(buffer) == u8"game/game.bkp/c++");
+                REQUIRE(fs::path(file.abs_path(buffer)) ==
+                        fs::current_path() / "test-folder/game/game.bkp/c++");
+            }
+        }
+        REQUIRE(sources == 3);
+        REQUIRE(std::ranges::distance(scanner.get_all_file_refs()) == 10);
+        REQUIRE(scanner.get_file_refs(u8"engine").empty());
+        REQUIRE(scanner.get_file_refs(u8"engine/no_dir").empty());
+    }
+
+    SECTION("snapshot test")
+    {
+        // directories are older than snapshot racy time
+        const auto old_time =
+            fs::file_time_type::clock::now() - std::chrono::hours(1);
+        for (const auto& p : fs::recursive_directory_iterator("test-folder"))
+        {
+            if (p.is_directory())
+                fs::last_write_time(p.path(), old_time);
+        }
+        fs::last_write_time("test-folder", old_time);
+
+        om::scanner_options options;
+        options.snapshot = u8"test-folder.snapshot";
+        fs::remove(options.snapshot);
+
+        om::scanner first(u8"test-folder", options);
+        REQUIRE(first.get_report().from_snapshot == false);
+        REQUIRE(fs::exists(options.snapshot));
+
+        om::scanner        second(u8"test-folder", options);
+        om::scanner_report report = second.get_report();
+        REQUIRE(report.from_snapshot == true);
+        REQUIRE(report.updated_folders == 0);
+        REQUIRE(report.total_files == 10);
+        REQUIRE(report.total_folders == 8);
+        REQUIRE(second.get_file_size(u8"русский/файл") == 94);
+        REQUIRE(second.get_files(u8"engine/src").size() == 4);
+        REQUIRE(second.find_files_with_name(u8"engine", u8"one").size() == 2);
+        REQUIRE(second.get_all_files().size() == 10);
+
+        fout.open("test-folder/game/level.txt");
+        fout << "level";
+        fout.close();
+        fs::remove_all("test-folder/engine/src/scanner/~.scanner");
+
+        om::scanner third(u8"test-folder", options);
+        report = third.get_report();
+        REQUIRE(report.from_snapshot == true);
+        REQUIRE(report.updated_folders == 2);
+        REQUIRE(report.total_files == 10);
+        REQUIRE(report.total_folders == 7);
+        REQUIRE(third.get_file_size(u8"game/level.txt") == 5);
+        REQUIRE(third.find_files_with_extension(u8"", u8"txt").size() == 1);
+        REQUIRE(third.find_files_with_extension(u8"", u8"cxx").size() == 3);
+        REQUIRE(third.is_file_exists(
+                    u8"engine/src/scanner/~.scanner/.gitignore") == false);
+        REQUIRE(third.get_all_files().size() == 10);
+
+        // other root does not use the same snapshot
+        om::scanner other(u8"test-folder/engine", options);
+        REQUIRE(other.get_report().from_snapshot == false);
+        REQUIRE(other.get_report().total_files == 4);
+
+        fs::remove(options.snapshot);
+    }
+
+    SECTION("content hash test")
+    {
+        fs::copy_file("test-folder/game/game.cxx", "test-folder/copy.cxx");
+        // files are older than racy time, so their hashes are reused
+        const auto old_time =
+            fs::file_time_type::clock::now() - std::chrono::hours(1);
+        for (const auto& p : fs::recursive_directory_iterator("test-folder"))
+        {
+            fs::last_write_time(p.path(), old_time);
+        }
+
+        om::scanner_options options;
+        options.hash_contents = true;
+        options.num_threads   = 2;
+        options.snapshot      = u8"test-folder.snapshot";
+        fs::remove(options.snapshot);
+
+        om::scanner        first(u8"test-folder", options);
+        om::scanner_report report = first.get_report();
+        REQUIRE(report.hashed_files == 11);
+        const om::content_hash game = first.get_file_hash(u8"game/game.cxx");
+        REQUIRE(game != om::content_hash{});
+        REQUIRE(game == first.get_file_hash(u8"copy.cxx"));
+        REQUIRE(game != first.get_file_hash(u8"readme.md"));
+        REQUIRE(first.get_file_hash(u8"engine/src/one.cxx") ==
+                first.get_file_hash(u8"engine/src/one.hxx"));
+        REQUIRE(first.get_file_hash(u8"no_file") == om::content_hash{});
+        REQUIRE(first.get_files(u8"game").front().hash == game);
+
+        auto duplicates = first.find_duplicates();
+        REQUIRE(duplicates.size() == 1); // empty files are not reported
+        REQUIRE(duplicates.front().size() == 2);
+        REQUIRE(duplicates.front().front().hash == game);
+
+        om::scanner second(u8"test-folder", options);
+        REQUIRE(second.get_report().hashed_files == 0);
+        REQUIRE(second.get_file_hash(u8"copy.cxx") == game);
+
+        fout.open("test-folder/copy.cxx", std::ios::app);
+        fout << "!";
+        fout.close();
+        fs::last_write_time("test-folder/copy.cxx",
+                            old_time + std::chrono::minutes(1));
+
+        om::scanner third(u8"test-folder", options);
+        REQUIRE(third.get_report().hashed_files == 1);
+        REQUIRE(third.get_file_hash(u8"copy.cxx") != game);
+        REQUIRE(third.find_duplicates().empty());
+
+        options.hash_contents = false;
+        om::scanner plain(u8"test-folder", options);
+        REQUIRE(plain.get_file_hash(u8"game/game.cxx") == om::content_hash{});
+        REQUIRE(plain.find_duplicates().empty());
+
+        fs::remove(options.snapshot);
+        fs::remove("test-folder/copy.cxx");
+    }
+
+    SECTION("async scan test")
+    {
+        om::scanner_options options;
+        options.async       = true;
+        options.num_threads = 2;
+
+        om::scanner scanner(u8"test-folder", options);
+        scanner.get_future().get();
+
+        const om::scan_progress progress = scanner.get_progress();
+        REQUIRE(progress.done);
+        REQUIRE(progress.folders == 9);
+        REQUIRE(progress.files == 10);
+        REQUIRE(scanner.get_report().initialized);
+        REQUIRE(scanner.get_all_files().size() == 10);
+        REQUIRE(scanner.find_files_with_extension(u8"", u8"cxx").size() == 3);
+        REQUIRE(std::ranges::distance(scanner.get_all_file_refs()) == 10);
+
+        om::scanner sync(u8"test-folder");
+        REQUIRE(sync.get_progress().done);
+        REQUIRE(sync.get_future().wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready);
+
+        om::scanner missing(u8"no-such-folder", options);
+        REQUIRE(missing.get_progress().done);
+        REQUIRE(missing.get_all_files().empty());
+    }
+
+#if defined(__linux__)
+    SECTION("watch mode test")
+    {
+        om::scanner_options options;
+        options.watch = true;
+
+        om::scanner scanner(u8"test-folder", options);
+        REQUIRE(scanner.get_report().watching == true);
+        REQUIRE(scanner.poll_changes().empty());
+
+        fout.open("test-folder/engine/src/three.cxx");
+        fout << "new file";
+        fout.close();
+        fout.open("test-folder/game/game.cxx");
+        fout << "Who";
+        fout.close();
+        fs::remove("test-folder/readme.md");
+        fs::create_directories("test-folder/assets/images");
+        fout.open("test-folder/assets/images/tank.png");
+        fout << "png";
+        fout.close();
+
+        std::vector<om::file_change> changes = scanner.poll_changes();
+        REQUIRE(changes.size() >= 4);
+        auto has_change = [&](std::u8string_view path, auto what)
+        {
+            return std::ranges::any_of(
+                changes,
+                [&](const om::file_change& change)
+                { return change.path == path && change.what == what; });
+        };
+        using type = om::file_change::type;
+        REQUIRE(has_change(u8"engine/src/three.cxx", type::created));
+        REQUIRE(has_change(u8"game/game.cxx", type::modified));
+        REQUIRE(has_change(u8"readme.md", type::removed));
+        REQUIRE(has_change(u8"assets/images/tank.png", type::created));
+
+        REQUIRE(scanner.get_file_size(u8"engine/src/three.cxx") == 8);
+        REQUIRE(scanner.get_file_size(u8"game/game.cxx") == 3);
+        REQUIRE(scanner.is_file_exists(u8"readme.md") == false);
+        REQUIRE(scanner.is_file_exists(u8"assets/images/tank.png") == true);
+        REQUIRE(scanner.get_files(u8"engine/src").size() == 5);
+        REQUIRE(scanner.find_files_with_extension(u8"", u8"png").size() == 1);
+        REQUIRE(scanner.find_files_with_extension(u8"", u8"cxx").size() == 4);
+        REQUIRE(scanner.get_report().total_files == 11);
+        REQUIRE(scanner.get_report().total_folders == 10);
+
+        fs::remove_all("test-folder/engine/src/scanner");
+        changes = scanner.poll_changes();
+        REQUIRE(has_change(u8"engine/src/scanner/~.scanner/.gitignore",
+                           type::removed));
+        REQUIRE(scanner.is_file_exists(
+                    u8"engine/src/scanner/~.scanner/.gitignore") == false);
+        REQUIRE(scanner.get_all_files().size() == 10);
+        REQUIRE(scanner.get_report().total_folders == 8);
+    }
+    SECTION("watch mode content hash test")
+    {
+        const auto old_time =
+            fs::file_time_type::clock::now() - std::chrono::hours(1);
+        fs::last_write_time("test-folder/readme.md", old_time);
+
+        om::scanner_options options;
+        options.watch         = true;
+        options.hash_contents = true;
+        om::scanner scanner(u8"test-folder", options);
+        const om::content_hash old_hash =
+            scanner.get_file_hash(u8"readme.md");
+        REQUIRE(old_hash != om::content_hash{});
+
+        fs::remove("test-folder/readme.md");
+        REQUIRE(!scanner.poll_changes().empty());
+
+        // the same size and mtime: record of removed file must be gone,
+        // or it would be reused for new content
+        fout.open("test-folder/readme.md");
+        fout << "Few black taxis drive up major roads on quiet hazy night!";
+        fout.close();
+        fs::last_write_time("test-folder/readme.md", old_time);
+        REQUIRE(!scanner.poll_changes().empty());
+        const om::content_hash new_hash =
+            scanner.get_file_hash(u8"readme.md");
+        REQUIRE(new_hash != om::content_hash{});
+        REQUIRE(new_hash != old_hash);
+    }
+#endif
+
     SECTION("get_file_size test")
     {
         om::scanner scanner(u8"test-folder");
@@ -139,6 +482,8 @@ TEST_CASE("scanner test")
             REQUIRE(scanner.is_file_exists(
                         u8"engine/src/scanner/~.scanner/.gitignore") == true);
             REQUIRE(scanner.is_file_exists(u8"русский/файл") == true);
+            REQUIRE(scanner.is_file_exists(u8"engine//src/one.cxx") == true);
+            REQUIRE(scanner.is_file_exists(u8"engine/src/two.hxx") == false);
         }
         SECTION("invalid request")
         {
@@ -235,6 +580,76 @@ TEST_CASE("scanner test")
         }
     }
 
+    SECTION("recursive queries test")
+    {
+        om::scanner scanner(u8"test-folder");
+
+        std::vector<om::file_info> files;
+        files = scanner.find_files_with_extension(u8"", u8"cxx");
+        REQUIRE(files.size() == 3);
+        files = scanner.find_files_with_extension(u8"engine", u8"cxx");
+        REQUIRE(files.size() == 2);
+        files = scanner.find_files_with_extension(u8"engine/src", u8"hxx");
+        REQUIRE(files.size() == 2);
+        files = scanner.find_files_with_extension(u8"engine/src/om", u8"cxx");
+        REQUIRE(files.empty());
+        files = scanner.find_files_with_extension(u8"game", u8"");
+        REQUIRE(files.size() == 1);
+        REQUIRE(files.front().size == 183);
+        files = scanner.find_files_with_extension(u8"", u8"gitignore");
+        REQUIRE(files.empty());
+        files = scanner.find_files_with_extension(u8"engine/no_dir", u8"cxx");
+        REQUIRE(files.empty());
+
+        files = scanner.find_files_with_name(u8"", u8"one");
+        REQUIRE(files.size() == 2);
+        files = scanner.find_files_with_name(u8"", u8".gitignore");
+        REQUIRE(files.size() == 1);
+        files = scanner.find_files_with_name(u8"game", u8"game");
+        REQUIRE(files.size() == 1);
+        files = scanner.find_files_with_name(u8"engine", u8"game");
+        REQUIRE(files.empty());
+        files = scanner.find_files_with_name(u8"", u8"");
+        REQUIRE(files.empty());
+    }
+
+    SECTION("glob test")
+    {
+        om::scanner scanner(u8"test-folder");
+
+        REQUIRE(scanner.find_files(u8"**/*.cxx").size() == 3);
+        REQUIRE(scanner.find_files(u8"**").size() == 10);
+        REQUIRE(scanner.find_files(u8"*.{yml,md}").size() == 2);
+        REQUIRE(scanner.find_files(u8"engine/src/???.cxx").size() == 2);
+        REQUIRE(scanner.find_files(u8"engine/src/[a-o]*.?xx").size() == 2);
+        REQUIRE(scanner.find_files(u8"engine/src/[!o]*").size() == 2);
+        REQUIRE(scanner.find_files(u8"engine/**/.gitignore").size() == 1);
+        REQUIRE(scanner.find_files(u8"{game,engine/src}/*.cxx").size() == 3);
+        REQUIRE(scanner.find_files(u8"{game,game}/game.cxx").size() == 1);
+        REQUIRE(scanner.find_files(u8"русский/????").size() == 1);
+        REQUIRE(scanner.find_files(u8"game/game.bkp/c++").front().size == 183);
+        REQUIRE(scanner.find_files(u8"engine/*").empty());
+        REQUIRE(scanner.find_files(u8"*.{yml").empty());
+        REQUIRE(scanner.find_files(u8"").empty());
+
+        om::glob_pattern level(u8"res/**/level_??.txt");
+        REQUIRE(level.is_valid());
+        REQUIRE(level.match(u8"res/level_01.txt"));
+        REQUIRE(level.match(u8"res/a/b/level_01.txt"));
+        REQUIRE(!level.match(u8"res/level_1.txt"));
+        REQUIRE(!level.match(u8"data/level_01.txt"));
+        REQUIRE(!om::glob_pattern(u8"[ab").is_valid());
+        REQUIRE(!om::glob_pattern(u8"a}").is_valid());
+
+        // at most 1024 alternatives, bigger expansion stops early
+        std::u8string braces;
+        for (int i = 0; i < 10; ++i)
+            braces += u8"{a,b}";
+        REQUIRE(om::glob_pattern(braces).is_valid());
+        REQUIRE(!om::glob_pattern(braces + u8"{a,b}").is_valid());
+        REQUIRE(!om::glob_pattern(braces + braces).is_valid());
+    }
+
     SECTION("get_all_files test")
     {
         om::scanner scanner(u8"test-folder");
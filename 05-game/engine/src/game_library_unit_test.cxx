@@ -0,0 +1,107 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/game_library.hxx"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// std::clog goes to string while alive
+struct clog_capture
+{
+    clog_capture()
+        : old(std::clog.rdbuf(text.rdbuf()))
+    {
+    }
+    ~clog_capture() { std::clog.rdbuf(old); }
+
+    size_t count(std::string_view part) const
+    {
+        const std::string log    = text.str();
+        size_t            result = 0;
+        for (size_t pos = log.find(part); pos != std::string::npos;
+             pos        = log.find(part, pos + 1))
+            ++result;
+        return result;
+    }
+
+    std::stringstream text;
+    std::streambuf*   old;
+};
+
+// polls till reloader gives up on failures-th load, false on timeout
+bool wait_failed_load(om::library_reloader& reloader,
+                      const clog_capture&   log,
+                      size_t                failures)
+{
+    const auto end =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (log.count("can't reload game") < failures)
+    {
+        om::game_library library;
+        if (reloader.poll(library) || std::chrono::steady_clock::now() > end)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+} // namespace
+
+TEST_CASE("game library test")
+{
+    SECTION("copy path alternates")
+    {
+        const fs::path folder("build");
+        const auto     path = (folder / "libgame.so").string();
+        REQUIRE(om::get_library_copy_path(path, 0) ==
+                (folder / "libtmp_game0.so").string());
+        REQUIRE(om::get_library_copy_path(path, 1) ==
+                (folder / "libtmp_game1.so").string());
+        REQUIRE(om::get_library_copy_path(path, 2) ==
+                (folder / "libtmp_game0.so").string());
+        REQUIRE(om::get_library_copy_path("game.dll", 7) == "tmp_game1.dll");
+        REQUIRE_THROWS_AS(om::get_library_copy_path("libmatch3.so", 0),
+                          std::runtime_error);
+    }
+    SECTION("failed load rolls generation back")
+    {
+        const fs::path folder = fs::temp_directory_path() / "om_library_test";
+        fs::remove_all(folder);
+        fs::create_directories(folder);
+        const fs::path library = folder / "libgame.so";
+        const fs::path copy0   = folder / "libtmp_game0.so";
+        const fs::path copy1   = folder / "libtmp_game1.so";
+        std::ofstream(library) << "not a library";
+
+        om::profiler p;
+        {
+            clog_capture         log;
+            om::library_reloader reloader(library.string(), p);
+
+            // build 1 is broken: its copy is written and load fails
+            std::ofstream(library) << "broken build 1";
+            REQUIRE(wait_failed_load(reloader, log, 1));
+            REQUIRE(fs::exists(copy1));
+            REQUIRE(!fs::exists(copy0));
+
+            // next build reuses copy of the same generation, copy 0 of
+            // running library is never overwritten
+            fs::remove(copy1);
+            std::ofstream(library) << "broken build 2";
+            REQUIRE(wait_failed_load(reloader, log, 2));
+            REQUIRE(fs::exists(copy1));
+            REQUIRE(!fs::exists(copy0));
+        }
+        fs::remove_all(folder);
+    }
+}
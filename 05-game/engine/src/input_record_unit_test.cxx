@@ -0,0 +1,143 @@
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/input_record.hxx"
+
+namespace
+{
+om::event key(om::event_type type, om::keys k)
+{
+    om::event e;
+    e.type = type;
+    e.key  = k;
+    return e;
+}
+
+bool same(const om::event& a, const om::event& b)
+{
+    return a.type == b.type &&
+           (a.type == om::event_type::quit || a.key == b.key);
+}
+
+// message of exception thrown on load of text
+std::string get_load_error(const std::filesystem::path& path,
+                           const std::string&           text)
+{
+    std::ofstream(path) << text;
+    om::input_record record;
+    try
+    {
+        record.load(path);
+    }
+    catch (const std::runtime_error& ex)
+    {
+        return ex.what();
+    }
+    return {};
+}
+} // namespace
+
+TEST_CASE("input record test")
+{
+    using om::event_type;
+    using om::keys;
+
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "om_input_record_test.txt";
+
+    SECTION("save and load")
+    {
+        const om::event events[] = {
+            key(event_type::key_down, keys::left),
+            key(event_type::key_up, keys::left),
+            key(event_type::key_down, keys::button2),
+            om::event{},
+        };
+        const size_t frames[] = { 0, 10, 10, 300 };
+
+        om::input_record record;
+        for (size_t i = 0; i < std::size(events); ++i)
+            record.add(frames[i], events[i]);
+        record.save(path);
+
+        om::input_record loaded;
+        loaded.load(path);
+        REQUIRE(loaded.size() == std::size(events));
+        om::event e;
+        for (size_t i = 0; i < std::size(events); ++i)
+        {
+            REQUIRE(loaded.next(frames[i], e));
+            REQUIRE(same(e, events[i]));
+        }
+        REQUIRE(!loaded.next(300, e));
+    }
+    SECTION("next order")
+    {
+        om::input_record record;
+        record.add(1, key(event_type::key_down, keys::up));
+        record.add(1, key(event_type::key_down, keys::down));
+        record.add(3, key(event_type::key_up, keys::up));
+        record.add(5, key(event_type::key_up, keys::down));
+
+        om::event e;
+        REQUIRE(!record.next(0, e));
+        REQUIRE(record.next(1, e));
+        REQUIRE(same(e, key(event_type::key_down, keys::up)));
+        REQUIRE(record.next(1, e));
+        REQUIRE(same(e, key(event_type::key_down, keys::down)));
+        REQUIRE(!record.next(1, e));
+        REQUIRE(!record.next(2, e));
+        // frame 3 is skipped, its event is not replayed late
+        REQUIRE(record.next(5, e));
+        REQUIRE(same(e, key(event_type::key_up, keys::down)));
+        REQUIRE(!record.next(5, e));
+        REQUIRE(!record.next(6, e));
+    }
+    SECTION("comments and empty lines")
+    {
+        std::ofstream(path) << "# frame type key\n\n2 key_down start\n"
+                               "#3 key_up start\n4 quit\n";
+        om::input_record record;
+        record.load(path);
+        REQUIRE(record.size() == 2);
+        om::event e;
+        REQUIRE(record.next(2, e));
+        REQUIRE(same(e, key(event_type::key_down, keys::start)));
+        REQUIRE(record.next(4, e));
+        REQUIRE(same(e, om::event{}));
+    }
+    SECTION("load errors")
+    {
+        const std::string prefix = path.string() + ':';
+        REQUIRE(get_load_error(path, "# header\n1 key_down left\n2 jump\n") ==
+                prefix + "3: bad input event: 2 jump");
+        REQUIRE(get_load_error(path, "\n1 key_down\n") ==
+                prefix + "2: bad input event: 1 key_down");
+        REQUIRE(get_load_error(path, "1 key_up middle\n") ==
+                prefix + "1: bad input event: 1 key_up middle");
+        REQUIRE(get_load_error(path, "5 quit\n\n4 quit\n") ==
+                prefix + "3: bad input event: 4 quit");
+        REQUIRE(get_load_error(path, "key_down left\n") ==
+                prefix + "1: bad input event: key_down left");
+
+        std::filesystem::remove(path);
+        om::input_record record;
+        REQUIRE_THROWS_AS(record.load(path), std::runtime_error);
+    }
+    SECTION("failed load keeps events")
+    {
+        om::input_record record;
+        record.add(7, key(event_type::key_down, keys::select));
+        std::ofstream(path) << "1 quit\nbad\n";
+        REQUIRE_THROWS_AS(record.load(path), std::runtime_error);
+        REQUIRE(record.size() == 1);
+        om::event e;
+        REQUIRE(record.next(7, e));
+    }
+    std::filesystem::remove(path);
+}
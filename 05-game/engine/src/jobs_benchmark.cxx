@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string_view>
+
+#include "om/jobs.hxx"
+
+// Usage: jobs_benchmark [--jobs N] [--workers N] [--repeats N]
+//
+// Every metric is the best of repeats, in nanoseconds per job: cost of
+// scheduling itself, jobs do almost nothing.
+
+namespace
+{
+
+// best time of repeats divided by count
+template <typename Func>
+double measure(size_t repeats, size_t count, Func&& func)
+{
+    using namespace std::chrono;
+    double best = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < repeats; ++i)
+    {
+        const auto start = steady_clock::now();
+        func();
+        const duration<double, std::nano> time = steady_clock::now() - start;
+        best = std::min(best, time.count() / static_cast<double>(count));
+    }
+    return best;
+}
+
+void print(std::string_view name, double value)
+{
+    std::cout << name << ": " << value << " ns/job\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t count   = 100'000;
+    size_t workers = 0; // all hardware threads
+    size_t repeats = 5;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string_view key   = argv[i];
+        const size_t           value = std::strtoul(argv[i + 1], nullptr, 10);
+        if (key == "--jobs")
+            count = value;
+        else if (key == "--workers")
+            workers = value;
+        else if (key == "--repeats")
+            repeats = value;
+        else
+            argc = 0; // unknown option
+    }
+    if (argc % 2 == 0 || count == 0 || repeats == 0)
+    {
+        std::cerr << "usage: jobs_benchmark [--option value]...\n"
+                     "options: --jobs --workers --repeats\n";
+        return EXIT_FAILURE;
+    }
+
+    om::job_system   jobs(workers);
+    std::atomic<int> sink{ 0 };
+    std::cout << "workers: " << jobs.get_worker_count() << '\n';
+
+    // main thread queues all jobs, workers steal them from its queue
+    print("spawn",
+          measure(repeats,
+                  count,
+                  [&]
+                  {
+                      om::job_counter counter;
+                      for (size_t i = 0; i < count; ++i)
+                          jobs.run(counter, [&sink] { sink++; });
+                      jobs.wait(counter);
+                  }));
+
+    // one worker queues all jobs into its own queue and runs them from
+    // the back, the others steal from the front
+    print("steal",
+          measure(repeats,
+                  count,
+                  [&]
+                  {
+                      om::job_counter counter;
+                      om::job_counter spawned;
+                      jobs.run(spawned,
+                               [&]
+                               {
+                                   for (size_t i = 0; i < count; ++i)
+                                       jobs.run(counter, [&sink] { sink++; });
+                                   jobs.wait(counter);
+                               });
+                      jobs.wait(spawned);
+                  }));
+
+    // latency of one job: queue, wake up somebody, wait
+    const size_t round_trips = std::max<size_t>(count / 10, 1);
+    print("wait",
+          measure(repeats,
+                  round_trips,
+                  [&]
+                  {
+                      for (size_t i = 0; i < round_trips; ++i)
+                      {
+                          om::job_counter counter;
+                          jobs.run(counter, [&sink] { sink++; });
+                          jobs.wait(counter);
+                      }
+                  }));
+
+    // every job waits for the previous one
+    print("dependency_chain",
+          measure(repeats,
+                  round_trips,
+                  [&]
+                  {
+                      auto chain =
+                          std::make_unique<om::job_counter[]>(round_trips);
+                      jobs.run(chain[0], [&sink] { sink++; });
+                      for (size_t i = 1; i < round_trips; ++i)
+                          jobs.run_after(
+                              chain[i - 1], chain[i], [&sink] { sink++; });
+                      jobs.wait(chain[round_trips - 1]);
+                  }));
+
+    print("parallel_for.grain_1",
+          measure(repeats,
+                  count,
+                  [&]
+                  {
+                      jobs.parallel_for(count,
+                                        1,
+                                        [&sink](size_t, size_t) { sink++; });
+                  }));
+
+    return EXIT_SUCCESS;
+}
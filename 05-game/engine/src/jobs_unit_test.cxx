@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/jobs.hxx"
+
+TEST_CASE("job system test")
+{
+    om::job_system jobs(3);
+    REQUIRE(jobs.get_worker_count() == 3);
+
+    SECTION("run and wait")
+    {
+        std::atomic<size_t> sum{ 0 };
+        om::job_counter     counter;
+        for (size_t i = 1; i <= 1000; ++i)
+            jobs.run(counter, [&sum, i] { sum += i; });
+        jobs.wait(counter);
+        REQUIRE(counter.is_done());
+        REQUIRE(sum == 500500);
+    }
+    SECTION("parallel for")
+    {
+        std::vector<int> hits(10007, 0);
+        jobs.parallel_for(hits.size(),
+                          64,
+                          [&](size_t begin, size_t end)
+                          {
+                              for (size_t i = begin; i < end; ++i)
+                                  ++hits[i];
+                          });
+        REQUIRE(std::accumulate(hits.begin(), hits.end(), 0) == 10007);
+        REQUIRE(std::ranges::count(hits, 1) == 10007);
+
+        bool called = false;
+        jobs.parallel_for(0, 1, [&](size_t, size_t) { called = true; });
+        REQUIRE(!called);
+    }
+    SECTION("dependency")
+    {
+        std::atomic<int> stage{ 0 };
+        std::atomic<int> order_errors{ 0 };
+        om::job_counter  first;
+        om::job_counter  second;
+        om::job_counter  third;
+        for (int i = 0; i < 100; ++i)
+            jobs.run(first,
+                     [&]
+                     {
+                         std::this_thread::yield();
+                         if (stage.load() != 0)
+                             ++order_errors;
+                     });
+        jobs.run_after(first, second, [&] { stage = 1; });
+        jobs.run_after(second,
+                       third,
+                       [&]
+                       {
+                           if (stage.load() != 1)
+                               ++order_errors;
+                           stage = 2;
+                       });
+        jobs.wait(third);
+        REQUIRE(stage == 2);
+        REQUIRE(order_errors == 0);
+        REQUIRE(first.is_done());
+
+        // dependency is already done, job is queued right away
+        om::job_counter after;
+        jobs.run_after(first, after, [&] { stage = 3; });
+        jobs.wait(after);
+        REQUIRE(stage == 3);
+    }
+    SECTION("nested jobs")
+    {
+        std::atomic<size_t> leaves{ 0 };
+        om::job_counter     counter;
+        for (int i = 0; i < 16; ++i)
+            jobs.run(counter,
+                     [&]
+                     {
+                         om::job_counter inner;
+                         for (int j = 0; j < 16; ++j)
+                             jobs.run(inner, [&] { ++leaves; });
+                         jobs.wait(inner);
+                     });
+        jobs.wait(counter);
+        REQUIRE(leaves == 256);
+    }
+    SECTION("exception")
+    {
+        std::atomic<int> done{ 0 };
+        om::job_counter  counter;
+        jobs.run(counter, [] { throw std::runtime_error("job failed"); });
+        for (int i = 0; i < 10; ++i)
+            jobs.run(counter, [&] { ++done; });
+        REQUIRE_THROWS_AS(jobs.wait(counter), std::runtime_error);
+        REQUIRE(done == 10);
+        // error is taken by wait, counter can be used again
+        jobs.run(counter, [&] { ++done; });
+        REQUIRE_NOTHROW(jobs.wait(counter));
+        REQUIRE(done == 11);
+    }
+}
+
+TEST_CASE("job system stop")
+{
+    std::atomic<size_t> done{ 0 };
+    std::atomic<size_t> started{ 0 };
+    om::job_counter     counter; // outlives jobs
+    {
+        om::job_system jobs(2, [&](size_t worker) { started += worker + 1; });
+        jobs.parallel_for(100,
+                          7,
+                          [&](size_t begin, size_t end)
+                          { done += end - begin; });
+        REQUIRE(done == 100);
+        // jobs nobody waits for still run before job system is destroyed
+        for (int i = 0; i < 1000; ++i)
+            jobs.run(counter, [&] { ++done; });
+    }
+    REQUIRE(done == 1100);
+    REQUIRE(started == 3); // workers 0 and 1
+    REQUIRE(counter.is_done());
+}
@@ -1,16 +1,130 @@
 #include "engine_impl.hxx"
 
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <SDL_stdinc.h>
+
 namespace om
 {
 
 engine::~engine() = default;
 
-engine_impl::engine_impl(int, char**)
+engine_impl::engine_impl(int argc, char** argv)
+    : jobs(0,
+           [this](size_t worker)
+           {
+               frame_profiler.set_thread_name("worker " +
+                                              std::to_string(worker));
+           })
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        std::string_view       value;
+        // "--name value" or "--name=value"
+        auto is_option = [&](std::string_view name)
+        {
+            if (arg == name && i + 1 < argc)
+                value = argv[++i];
+            else if (arg.starts_with(name) && arg.size() > name.size() &&
+                     arg[name.size()] == '=')
+                value = arg.substr(name.size() + 1);
+            else
+                return false;
+            return true;
+        };
+
+        if (arg == "--headless")
+            headless = true;
+        else if (is_option("--trace"))
+            trace_path = value;
+        else if (is_option("--frames"))
+            max_frames = std::stoul(std::string(value));
+        else if (is_option("--replay"))
+        {
+            input.load(value);
+            replaying = true;
+        }
+        else if (is_option("--record"))
+            record_path = value;
+        else if (is_option("--report"))
+            report_path = value;
+        else if (is_option("--baseline"))
+            baseline_path = value;
+        else if (is_option("--tolerance"))
+            tolerance = std::stod(std::string(value));
+    }
+    if (replaying && !record_path.empty())
+        throw std::invalid_argument("--replay and --record are exclusive");
+
+    if (headless)
+    {
+        // games which init SDL video or audio get drivers without devices
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+        pacer.set_simulated(true);
+    }
+    if (!trace_path.empty())
+    {
+        frame_profiler.enable_trace();
+        frame_profiler.set_thread_name("main");
+    }
+}
+
+engine_impl::~engine_impl()
+{
+    try
+    {
+        if (!record_path.empty())
+        {
+            input.save(record_path);
+            std::clog << "input record: " << record_path.string() << std::endl;
+        }
+        if (!trace_path.empty())
+        {
+            frame_profiler.write_trace(trace_path);
+            std::clog << "trace: " << trace_path.string() << std::endl;
+        }
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "error: " << ex.what() << std::endl;
+    }
+}
+
+void engine_impl::initialize(params p)
+{
+    pacer.set_frame_rate(p.frame_rate);
+    pacer.set_update_rate(p.update_rate);
+    resources.set_memory_budget(p.resource_budget);
+}
+
+double engine_impl::get_frame_alpha() const
+{
+    return pacer.alpha();
+}
+
+state_arena& engine_impl::get_state_arena()
+{
+    return arena;
+}
+
+std::vector<zone_stats> engine_impl::get_frame_stats() const
+{
+    return frame_profiler.get_stats();
+}
+
+job_system& engine_impl::get_jobs()
 {
+    return jobs;
 }
 
-void engine_impl::initialize(params)
+resource_manager& engine_impl::get_resources()
 {
+    return resources;
 }
 
 } // end namespace om
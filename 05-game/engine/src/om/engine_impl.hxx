@@ -1,17 +1,58 @@
 #pragma once
 
+#include "frame_pacer.hxx"
+#include "input_record.hxx"
 #include "om/engine.hxx"
+#include "profiler.hxx"
+
+#include <filesystem>
 
 namespace om
 {
 
 struct engine_impl final : engine
 {
+    // --trace <file.json> records Chrome trace of the whole run
+    // --headless simulated clock, no waits, SDL dummy video and audio
+    // --frames <count> stops after count frames
+    // --replay <file> takes input from record instead of devices
+    // --record <file> saves input of the run
+    // --report <file.json> frames per second and zone percentiles
+    // --baseline <file.json> fails run if it is worse than that report
+    // --tolerance <percent> allowed difference from baseline, 20 by default
     engine_impl(int argc, char** argv);
+    ~engine_impl() final;
+
+    void                    initialize(params) final;
+    double                  get_frame_alpha() const final;
+    state_arena&            get_state_arena() final;
+    std::vector<zone_stats> get_frame_stats() const final;
+    job_system&             get_jobs() final;
+    resource_manager&       get_resources() final;
 
-    void initialize(params) final;
+    frame_pacer      pacer;
+    state_arena      arena; // game state kept over library reload
+    profiler         frame_profiler;
+    zone_id          events_zone = frame_profiler.add_zone("events");
+    zone_id          update_zone = frame_profiler.add_zone("update");
+    zone_id          draw_zone   = frame_profiler.add_zone("draw");
+    zone_id          reload_zone = frame_profiler.add_zone("reload");
+    zone_id          frame_zone  = frame_profiler.add_zone("frame"); // no wait
+    zone_id          steps_count = frame_profiler.add_zone("update steps");
+    zone_id          upload_zone = frame_profiler.add_zone("upload");
+    void*            so_handle   = nullptr;
+    job_system       jobs; // after profiler, workers write to it
+    resource_manager resources{ jobs };
 
-    void* so_handle = nullptr;
+    input_record          input; // replayed or recorded
+    std::filesystem::path trace_path;
+    std::filesystem::path record_path;
+    std::filesystem::path report_path;
+    std::filesystem::path baseline_path;
+    double                tolerance  = 20.0; // percent
+    size_t                max_frames = 0;    // 0 - till game is closed
+    bool                  headless   = false;
+    bool                  replaying  = false;
 };
 
 } // end namespace om
@@ -0,0 +1,168 @@
+#include "frame_pacer.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#endif
+
+namespace om
+{
+
+namespace
+{
+using namespace std::chrono;
+
+// spin margin follows how late sleep wakes up on this system
+constexpr frame_pacer::duration min_spin_margin = microseconds(50);
+constexpr frame_pacer::duration max_spin_margin = milliseconds(2);
+// one long frame (loading, debugger) does not start avalanche of updates
+constexpr int max_steps_per_frame = 8;
+
+frame_pacer::duration get_period(double fps)
+{
+    if (fps <= 0)
+        return frame_pacer::duration::zero();
+    return duration_cast<frame_pacer::duration>(duration<double>(1.0 / fps));
+}
+} // namespace
+
+frame_pacer::frame_pacer(double frame_rate, double update_rate)
+{
+    set_frame_rate(frame_rate);
+    set_update_rate(update_rate);
+    restart();
+}
+
+void frame_pacer::set_frame_rate(double fps)
+{
+    period = get_period(fps);
+}
+
+void frame_pacer::set_update_rate(double fps)
+{
+    if (fps <= 0)
+        throw std::invalid_argument("update rate has to be positive");
+    fixed_step  = get_period(fps);
+    accumulator = std::min(accumulator, fixed_step);
+}
+
+void frame_pacer::set_simulated(bool is_simulated)
+{
+    simulated = is_simulated;
+}
+
+void frame_pacer::restart()
+{
+    frame_start = clock::now();
+    deadline    = frame_start;
+    accumulator = duration::zero();
+}
+
+frame_pacer::duration frame_pacer::wait_next_frame()
+{
+    if (simulated)
+    {
+        ++frames;
+        accumulator = fixed_step;
+        return fixed_step;
+    }
+
+    if (period != duration::zero())
+    {
+        deadline += period;
+        if (clock::now() > deadline)
+        {
+            // frame took too long, start new schedule from now instead of
+            // running several short frames to catch up
+            ++late_frames;
+            deadline = clock::now();
+        }
+        else
+        {
+            sleep_until(deadline);
+        }
+    }
+
+    const clock::time_point now   = clock::now();
+    const duration          delta = now - frame_start;
+    frame_start                   = now;
+
+    if (period != duration::zero())
+    {
+        const duration error =
+            delta > period ? delta - period : period - delta;
+        error_sum += error;
+        error_max = std::max(error_max, error);
+    }
+    ++frames;
+
+    accumulator =
+        std::min(accumulator + delta, fixed_step * max_steps_per_frame);
+    return delta;
+}
+
+bool frame_pacer::step()
+{
+    if (accumulator < fixed_step)
+        return false;
+    accumulator -= fixed_step;
+    return true;
+}
+
+double frame_pacer::alpha() const
+{
+    return static_cast<double>(accumulator.count()) /
+           static_cast<double>(fixed_step.count());
+}
+
+pacing_report frame_pacer::get_report() const
+{
+    pacing_report result;
+    result.target      = duration_cast<nanoseconds>(period);
+    result.max_error   = duration_cast<nanoseconds>(error_max);
+    result.spin_margin = duration_cast<nanoseconds>(spin_margin);
+    result.frames      = frames;
+    result.late_frames = late_frames;
+    if (frames != 0)
+        result.mean_error = duration_cast<nanoseconds>(error_sum) /
+                            static_cast<nanoseconds::rep>(frames);
+    return result;
+}
+
+void frame_pacer::sleep_until(clock::time_point time)
+{
+    const clock::time_point wake_up = time - spin_margin;
+    if (clock::now() < wake_up)
+    {
+#if defined(__linux__)
+        // steady_clock is CLOCK_MONOTONIC, absolute time does not drift
+        // when sleep is interrupted by signal
+        const auto ns =
+            duration_cast<nanoseconds>(wake_up.time_since_epoch()).count();
+        timespec until{};
+        until.tv_sec  = static_cast<time_t>(ns / 1'000'000'000);
+        until.tv_nsec = static_cast<long>(ns % 1'000'000'000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until,
+                               nullptr) == EINTR)
+        {
+        }
+#else
+        std::this_thread::sleep_until(wake_up);
+#endif
+        // keep margin about twice as long as recent oversleep
+        const duration late = clock::now() - wake_up;
+        spin_margin = std::clamp((spin_margin * 7 + late * 2) / 8,
+                                 min_spin_margin,
+                                 max_spin_margin);
+    }
+    while (clock::now() < time)
+    {
+        std::this_thread::yield();
+    }
+}
+
+} // end namespace om
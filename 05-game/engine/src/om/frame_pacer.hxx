@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace om
+{
+
+struct pacing_report
+{
+    std::chrono::nanoseconds target{ 0 };
+    std::chrono::nanoseconds mean_error{ 0 }; // |achieved - target|
+    std::chrono::nanoseconds max_error{ 0 };
+    std::chrono::nanoseconds spin_margin{ 0 };
+    size_t                   frames{ 0 };
+    size_t                   late_frames{ 0 }; // missed deadline
+};
+
+// Keeps frames on target rate: sleeps most of the time left, then spins
+// the last part, so idle frame costs almost no CPU and still starts on
+// time. Also runs fixed timestep accumulator for game update.
+class frame_pacer
+{
+public:
+    using clock    = std::chrono::steady_clock;
+    using duration = clock::duration;
+
+    explicit frame_pacer(double frame_rate = 60.0, double update_rate = 60.0);
+
+    void set_frame_rate(double fps);  // 0 - do not wait at all
+    void set_update_rate(double fps); // fixed update step
+    // simulated clock: no wait, every frame is exactly one update step,
+    // so run does not depend on speed of machine
+    void set_simulated(bool is_simulated);
+    void restart(); // after long pause (loading), forget time passed
+    // wait till next frame deadline, returns time since previous frame
+    duration wait_next_frame();
+    // fixed timestep: while (pacer.step()) game.update(pacer.update_step())
+    [[nodiscard]] bool     step();
+    [[nodiscard]] duration update_step() const { return fixed_step; }
+    // part of update step not simulated yet, to interpolate draw [0, 1)
+    [[nodiscard]] double        alpha() const;
+    [[nodiscard]] pacing_report get_report() const;
+
+private:
+    void sleep_until(clock::time_point time);
+
+    clock::time_point frame_start{};
+    clock::time_point deadline{};
+    duration          period{ 0 };
+    duration          fixed_step{ 0 };
+    duration          accumulator{ 0 };
+    duration          spin_margin{ std::chrono::milliseconds(1) };
+    duration          error_sum{ 0 };
+    duration          error_max{ 0 };
+    size_t            frames{ 0 };
+    size_t            late_frames{ 0 };
+    bool              simulated{ false };
+};
+
+} // end namespace om
@@ -0,0 +1,262 @@
+#include "game_library.hxx"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+#include <SDL_loadso.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace om
+{
+
+#if defined(__MINGW32__) || defined(__linux__)
+static std::string_view get_cxx_mangled_name()
+{
+    return "_Z11create_gameRN2om6engineE";
+}
+#elif defined(_MSC_VER)
+static std::string_view get_cxx_mangled_name()
+{
+    // how to get it:
+    // c:\Program Files (x86)\Microsoft Visual Studio\2019\Professional>dumpbin /exports C:\build-dir\om\05-game\engine\Debug\game.dll
+    return "?create_game@@YA?AV?$unique_ptr@Ugame@om@@U?$default_delete@Ugame@om@@@std@@@std@@AEAUengine@om@@@Z";
+}
+#else
+#error "add mangled name for your compiler"
+#endif
+
+std::string get_library_copy_path(const std::string& path, size_t generation)
+{
+    const fs::path file(path);
+    std::string    name     = file.filename().string();
+    const size_t   position = name.find("game");
+    if (position == std::string::npos)
+        throw std::runtime_error("no \"game\" in library name: " + path);
+    name.replace(position, 4, "tmp_game" + std::to_string(generation % 2));
+    return (file.parent_path() / name).string();
+}
+
+game_library load_game_library(const std::string& path,
+                               const std::string& copy_path)
+{
+    using namespace std::string_literals;
+
+    try
+    {
+        std::ifstream src_so;
+        std::ofstream dst_so;
+
+        src_so.exceptions(std::ios::failbit | std::ios::badbit);
+        dst_so.exceptions(std::ios::failbit | std::ios::badbit);
+
+        src_so.open(path, std::ios::binary);
+        dst_so.open(copy_path, std::ios::binary);
+        dst_so << src_so.rdbuf();
+    }
+    catch (std::exception& ex)
+    {
+        std::clog << "can't copy dll: " << ex.what() << std::endl;
+        throw;
+    }
+
+    void* so_handle = SDL_LoadObject(copy_path.c_str());
+    if (nullptr == so_handle)
+    {
+        std::string err_msg = SDL_GetError();
+        throw std::runtime_error("can't load: "s + copy_path + " " + err_msg);
+    }
+
+    std::string_view func_name = get_cxx_mangled_name();
+
+    void* func_address = SDL_LoadFunction(so_handle, func_name.data());
+
+    if (nullptr == func_address)
+    {
+        SDL_UnloadObject(so_handle);
+        throw std::runtime_error(
+            "can't find "s +
+            "std::unique_ptr<om::game> create_game(om::engine&) "s +
+            "mangled name: "s + func_name.data() + " in so: " + copy_path);
+    }
+
+    game_library result;
+    result.handle = so_handle;
+    result.create = reinterpret_cast<create_game_func>(func_address);
+    return result;
+}
+
+library_reloader::library_reloader(std::string path_, profiler& owner_)
+    : owner(owner_)
+    , path(std::move(path_))
+    , name(fs::path(path).filename().string())
+    , changed_zone(owner.add_zone("library changed"))
+    , load_zone(owner.add_zone("load library"))
+{
+#if defined(__linux__)
+    // only finished writes: linker closes the file, or build tool moves
+    // new file in place, half written library is never loaded
+    fs::path folder = fs::path(path).parent_path();
+    if (folder.empty())
+        folder = ".";
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd >= 0 &&
+        inotify_add_watch(watch_fd,
+                          folder.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0)
+    {
+        close(watch_fd);
+        watch_fd = -1;
+    }
+#endif
+    std::error_code error;
+    last_write = fs::last_write_time(path, error);
+    loader     = std::thread(&library_reloader::run_loader, this);
+}
+
+library_reloader::~library_reloader()
+{
+    {
+        std::lock_guard lock(mutex);
+        is_stopping = true;
+        task        = {}; // not started load gives broken promise
+    }
+    wake.notify_one();
+    loader.join();
+
+    if (loading.valid())
+    {
+        try
+        {
+            SDL_UnloadObject(loading.get().handle); // never swapped in
+        }
+        catch (...)
+        {
+        }
+    }
+#if defined(__linux__)
+    if (watch_fd >= 0)
+        close(watch_fd);
+#endif
+}
+
+bool library_reloader::poll(game_library& result)
+{
+    if (is_changed())
+    {
+        owner.instant(changed_zone);
+        is_pending = true;
+    }
+
+    if (loading.valid())
+    {
+        if (loading.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+            return false;
+        try
+        {
+            result = loading.get();
+            return true;
+        }
+        catch (std::exception& ex)
+        {
+            // copy of this generation is free, next try reuses it
+            --generation;
+            std::clog << "can't reload game: " << ex.what() << std::endl;
+        }
+    }
+
+    if (is_pending)
+    {
+        // started only after previous result was taken, so copy of the
+        // generation before previous one is already unloaded
+        is_pending = false;
+        ++generation;
+        std::packaged_task<game_library()> next(
+            [this, copy_path = get_library_copy_path(path, generation)]
+            {
+                scoped_zone zone(owner, load_zone);
+                return load_game_library(path, copy_path);
+            });
+        loading = next.get_future();
+        {
+            std::lock_guard lock(mutex);
+            task = std::move(next);
+        }
+        wake.notify_one();
+    }
+    return false;
+}
+
+// One thread for all reloads, so profiler data of the thread is created
+// once and not for every new build
+void library_reloader::run_loader()
+{
+    owner.set_thread_name("library loader");
+    for (;;)
+    {
+        std::packaged_task<game_library()> current;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this] { return is_stopping || task.valid(); });
+            if (is_stopping)
+                return;
+            current = std::move(task);
+        }
+        current();
+    }
+}
+
+bool library_reloader::is_changed()
+{
+#if defined(__linux__)
+    if (watch_fd >= 0)
+    {
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            const ssize_t length = read(watch_fd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break; // EAGAIN, no more events
+            for (const char* ptr = buffer; ptr < buffer + length;)
+            {
+                const auto& event =
+                    *reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event.len;
+                if (event.len != 0 && name == event.name)
+                    changed = true;
+            }
+        }
+        return changed;
+    }
+#endif
+    // no inotify: stat twice a second and load when file stops changing
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_check)
+        return false;
+    next_check = now + std::chrono::milliseconds(500);
+
+    std::error_code error;
+    const auto      time = fs::last_write_time(path, error);
+    if (error)
+        return false;
+    if (time != last_write)
+    {
+        last_write = time;
+        is_written = true;
+        return false;
+    }
+    const bool changed = is_written;
+    is_written         = false;
+    return changed;
+}
+
+} // end namespace om
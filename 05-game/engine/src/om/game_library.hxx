@@ -0,0 +1,73 @@
+#pragma once
+
+#include "om/game.hxx"
+#include "profiler.hxx"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace om
+{
+
+using create_game_func = std::unique_ptr<game> (*)(engine&);
+
+struct game_library
+{
+    void*            handle = nullptr;
+    create_game_func create = nullptr;
+};
+
+// Library is loaded from a copy, so original file stays free for linker.
+// Two copies take turns: new build is loaded while old one still runs.
+std::string get_library_copy_path(const std::string& path, size_t generation);
+
+// Throws std::runtime_error on failure
+game_library load_game_library(const std::string& path,
+                               const std::string& copy_path);
+
+// Watches game library file and loads every new build on one background
+// thread that lives as long as reloader, main loop only swaps ready
+// library between frames
+class library_reloader
+{
+public:
+    // library of generation 0 is already loaded
+    library_reloader(std::string path, profiler& owner);
+    ~library_reloader();
+    library_reloader(const library_reloader&)            = delete;
+    library_reloader& operator=(const library_reloader&) = delete;
+
+    // does not block, true if new library is loaded and has to replace
+    // the current one; failed load is logged and old library is kept
+    bool poll(game_library& result);
+
+private:
+    bool is_changed();
+    void run_loader();
+
+    profiler&                             owner;
+    std::string                           path;
+    std::string                           name;
+    std::future<game_library>             loading;
+    std::filesystem::file_time_type       last_write{};
+    std::chrono::steady_clock::time_point next_check{};
+    size_t                                generation{ 0 };
+    zone_id                               changed_zone;
+    zone_id                               load_zone;
+    int                                   watch_fd{ -1 };
+    bool                                  is_pending{ false };
+    bool                                  is_written{ false }; // no inotify
+    std::mutex                            mutex;
+    std::condition_variable               wake;
+    std::packaged_task<game_library()>    task; // next load, under mutex
+    bool                                  is_stopping{ false }; // under mutex
+    std::thread                           loader; // started last
+};
+
+} // end namespace om
@@ -0,0 +1,111 @@
+#include "input_record.hxx"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace om
+{
+
+namespace
+{
+constexpr std::array<std::string_view, 3> type_names{ "key_down",
+                                                      "key_up",
+                                                      "quit" };
+constexpr std::array<std::string_view, 8> key_names{
+    "left", "right", "up", "down", "select", "start", "button1", "button2"
+};
+
+// index of name in names, names.size() if there is no such
+template <size_t count>
+size_t find_name(const std::array<std::string_view, count>& names,
+                 std::string_view                           name)
+{
+    return static_cast<size_t>(std::ranges::find(names, name) - names.begin());
+}
+} // namespace
+
+void input_record::add(size_t frame, const event& e)
+{
+    entries.push_back(entry{ frame, e });
+}
+
+bool input_record::next(size_t frame, event& e)
+{
+    // events of skipped frames are lost, not replayed late
+    while (position < entries.size() && entries[position].frame < frame)
+        ++position;
+    if (position == entries.size() || entries[position].frame != frame)
+        return false;
+    e = entries[position++].e;
+    return true;
+}
+
+void input_record::load(const std::filesystem::path& path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("can't open input record: " + path.string());
+
+    std::vector<entry> result;
+    std::string        line;
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        auto bad_line = [&]
+        {
+            return std::runtime_error(path.string() + ':' +
+                                      std::to_string(number) +
+                                      ": bad input event: " + line);
+        };
+
+        std::istringstream fields(line);
+        entry              item{};
+        std::string        name;
+        if (!(fields >> item.frame >> name) ||
+            (!result.empty() && item.frame < result.back().frame))
+            throw bad_line();
+
+        const size_t type = find_name(type_names, name);
+        if (type == type_names.size())
+            throw bad_line();
+        item.e.type = static_cast<event_type>(type);
+
+        if (item.e.type != event_type::quit)
+        {
+            const size_t key =
+                fields >> name ? find_name(key_names, name) : key_names.size();
+            if (key == key_names.size())
+                throw bad_line();
+            item.e.key = static_cast<keys>(key);
+        }
+        result.push_back(item);
+    }
+    entries  = std::move(result);
+    position = 0;
+}
+
+void input_record::save(const std::filesystem::path& path) const
+{
+    std::ofstream out(path);
+    out << "# frame type key\n";
+    for (const entry& item : entries)
+    {
+        out << item.frame << ' '
+            << type_names[static_cast<size_t>(item.e.type)];
+        if (item.e.type != event_type::quit)
+            out << ' ' << key_names[static_cast<size_t>(item.e.key)];
+        out << '\n';
+    }
+    if (!out)
+        throw std::runtime_error("can't write input record: " +
+                                 path.string());
+}
+
+} // end namespace om
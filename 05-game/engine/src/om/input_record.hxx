@@ -0,0 +1,37 @@
+#pragma once
+
+#include "om/engine.hxx"
+
+#include <filesystem>
+#include <vector>
+
+namespace om
+{
+
+// Input events of a run by frame number, to replay the run exactly.
+// File is text, one event per line: "<frame> <type> [key]", for example
+// "120 key_down left"; empty lines and lines from '#' are skipped.
+class input_record
+{
+public:
+    void add(size_t frame, const event& e);
+    // events of frames in increasing order, false after last one of frame
+    bool next(size_t frame, event& e);
+    [[nodiscard]] size_t size() const { return entries.size(); }
+
+    // throw std::runtime_error with line number on bad file
+    void load(const std::filesystem::path& path);
+    void save(const std::filesystem::path& path) const;
+
+private:
+    struct entry
+    {
+        size_t frame;
+        event  e;
+    };
+
+    std::vector<entry> entries;
+    size_t             position = 0; // next entry to replay
+};
+
+} // end namespace om
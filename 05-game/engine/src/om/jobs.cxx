@@ -0,0 +1,254 @@
+#include "om/jobs.hxx"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace om
+{
+
+namespace
+{
+// yields of idle worker before it sleeps, keeps wake up latency low
+// while jobs come one after another
+constexpr int idle_spins = 64;
+} // namespace
+
+struct job_system::impl
+{
+    // own cache line each, owner and thieves of one queue do not slow
+    // down the others
+    struct alignas(64) queue
+    {
+        std::mutex      mutex;
+        std::deque<job> jobs;
+    };
+
+    size_t get_index() const;
+    void   push(size_t index, const job& task);
+    bool   try_run(size_t index);
+    void   run_job(const job& task);
+    void   finish(job_counter& counter);
+    void   work(size_t index);
+
+    std::unique_ptr<queue[]>           queues; // 0 - not worker threads
+    size_t                             count = 0;
+    std::vector<std::thread>           workers;
+    std::function<void(size_t worker)> on_start;
+    std::atomic<size_t>                queued{ 0 };
+    std::atomic<size_t>                sleeping{ 0 };
+    std::atomic<std::uint32_t>         epoch{ 0 }; // changes to wake up
+    std::atomic<bool>                  stopping{ false };
+};
+
+namespace
+{
+thread_local const void* current_system = nullptr; // impl of worker
+thread_local size_t      current_queue  = 0;
+} // namespace
+
+size_t job_system::impl::get_index() const
+{
+    return current_system == this ? current_queue : 0;
+}
+
+void job_system::impl::push(size_t index, const job& task)
+{
+    {
+        std::lock_guard lock(queues[index].mutex);
+        queues[index].jobs.push_back(task);
+    }
+    // pairs with sleeping/queued in work(): either worker sees new job
+    // or we see the worker and wake it up
+    queued.fetch_add(1);
+    if (sleeping.load() != 0)
+    {
+        epoch.fetch_add(1);
+        epoch.notify_one();
+    }
+}
+
+bool job_system::impl::try_run(size_t index)
+{
+    if (queued.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    job  task;
+    bool found = false;
+    {
+        queue&          own = queues[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            task = own.jobs.back();
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; i < count && !found; ++i)
+    {
+        queue&          victim = queues[(index + i) % count];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            task = victim.jobs.front();
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+    if (!found)
+        return false;
+
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    run_job(task);
+    return true;
+}
+
+void job_system::impl::run_job(const job& task)
+{
+    try
+    {
+        task.invoke(task);
+    }
+    catch (...)
+    {
+        std::lock_guard lock(task.counter->mutex);
+        if (!task.counter->error)
+            task.counter->error = std::current_exception();
+    }
+    finish(*task.counter);
+}
+
+// Counter is not touched after it becomes 0, waiting thread may destroy
+// it right away. Last job takes counter mutex so continuation can't be
+// added between check and decrement, wait() takes it too before return.
+void job_system::impl::finish(job_counter& counter)
+{
+    size_t left = counter.pending.load(std::memory_order_relaxed);
+    while (left > 1 &&
+           !counter.pending.compare_exchange_weak(
+               left, left - 1, std::memory_order_acq_rel))
+    {
+    }
+    if (left > 1)
+        return;
+
+    std::vector<job> continuations;
+    {
+        std::lock_guard lock(counter.mutex);
+        if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            continuations.swap(counter.continuations);
+    }
+    const size_t index = get_index();
+    for (const job& task : continuations)
+        push(index, task);
+}
+
+void job_system::impl::work(size_t index)
+{
+    current_system = this;
+    current_queue  = index;
+    if (on_start)
+        on_start(index - 1);
+
+    for (;;)
+    {
+        if (try_run(index))
+            continue;
+
+        bool has_jobs = false;
+        for (int i = 0; i < idle_spins && !has_jobs; ++i)
+        {
+            std::this_thread::yield();
+            has_jobs = queued.load(std::memory_order_relaxed) != 0;
+        }
+        if (has_jobs)
+            continue;
+
+        const std::uint32_t ticket = epoch.load();
+        sleeping.fetch_add(1);
+        if (queued.load() == 0)
+        {
+            if (stopping.load())
+            {
+                sleeping.fetch_sub(1);
+                return;
+            }
+            epoch.wait(ticket);
+        }
+        sleeping.fetch_sub(1);
+    }
+}
+
+job_system::job_system(size_t                             num_workers,
+                       std::function<void(size_t worker)> on_start)
+    : pImpl(new impl)
+{
+    if (num_workers == 0)
+        num_workers =
+            std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+    pImpl->count    = num_workers + 1;
+    pImpl->queues   = std::make_unique<impl::queue[]>(pImpl->count);
+    pImpl->on_start = std::move(on_start);
+    pImpl->workers.reserve(num_workers);
+    for (size_t i = 1; i <= num_workers; ++i)
+        pImpl->workers.emplace_back([this, i] { pImpl->work(i); });
+}
+
+job_system::~job_system()
+{
+    pImpl->stopping.store(true);
+    pImpl->epoch.fetch_add(1);
+    pImpl->epoch.notify_all();
+    for (std::thread& worker : pImpl->workers)
+        worker.join();
+    while (pImpl->try_run(0)) // no workers, or jobs queued while they stop
+    {
+    }
+    delete pImpl;
+}
+
+size_t job_system::get_worker_count() const
+{
+    return pImpl->workers.size();
+}
+
+void job_system::wait(job_counter& counter)
+{
+    const size_t index = pImpl->get_index();
+    while (!counter.is_done())
+    {
+        if (!pImpl->try_run(index))
+            std::this_thread::yield();
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard lock(counter.mutex); // last job has left it
+        error = std::exchange(counter.error, nullptr);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void job_system::push(const job& task)
+{
+    pImpl->push(pImpl->get_index(), task);
+}
+
+void job_system::push_after(job_counter& dependency, const job& task)
+{
+    {
+        std::lock_guard lock(dependency.mutex);
+        if (dependency.pending.load(std::memory_order_acquire) != 0)
+        {
+            dependency.continuations.push_back(task);
+            return;
+        }
+    }
+    push(task);
+}
+
+} // end namespace om
@@ -1,31 +1,36 @@
 #include "engine_impl.hxx"
+#include "game_library.hxx"
+#include "metrics.hxx"
 #include "om/game.hxx"
 
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
 #include <format>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-#include <thread>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <SDL_loadso.h>
 
-namespace fs = std::filesystem;
-
 namespace om
 {
-struct event
-{
-};
-
 game::~game() = default;
 } // namespace om
 
-void             init_minimal_log_system();
-void             start_game(om::engine_impl&);
-bool             pool_event(om::event&);
-std::string_view get_cxx_mangled_name();
+void init_minimal_log_system();
+void start_game(om::engine_impl&);
+std::vector<om::metric> get_run_metrics(
+    size_t                             frames,
+    double                             frames_per_second,
+    const std::vector<om::zone_stats>& stats);
+void write_report(const std::filesystem::path&   path,
+                  const std::vector<om::metric>& metrics);
+bool pool_event(om::event&);
 
 int main(int argc, char* argv[])
 {
@@ -70,22 +75,6 @@ std::unique_ptr<om::game> call_create_game(om::engine& e)
 
 #if !defined(OM_STATIC)
 
-#if defined(__MINGW32__) || defined(__linux__)
-std::string_view get_cxx_mangled_name()
-{
-    return "_Z11create_gameRN2om6engineE";
-}
-#elif defined(_MSC_VER)
-std::string_view get_cxx_mangled_name()
-{
-    // how to get it:
-    // c:\Program Files (x86)\Microsoft Visual Studio\2019\Professional>dumpbin /exports C:\build-dir\om\05-game\engine\Debug\game.dll
-    return "?create_game@@YA?AV?$unique_ptr@Ugame@om@@U?$default_delete@Ugame@om@@@std@@@std@@AEAUengine@om@@@Z";
-}
-#else
-#error "add mangled name for your compiler"
-#endif
-
 #if defined(_WIN32) && defined(__MINGW32__)
 std::string get_game_library_path(om::engine&)
 {
@@ -110,58 +99,13 @@ std::string get_game_library_path(om::engine&)
 
 std::unique_ptr<om::game> call_create_game(om::engine_impl& e)
 {
-    using namespace std::string_literals;
-
     auto game_so_name = get_game_library_path(e);
     std::clog << "base game dll: " << game_so_name << std::endl;
-    auto tmp_game = game_so_name;
-    tmp_game.replace(tmp_game.find("game"), 4, "tmp_game");
-
-    try
-    {
-        std::ifstream src_so;
-        std::ofstream dst_so;
-
-        src_so.exceptions(std::ios::failbit | std::ios::badbit);
-        dst_so.exceptions(std::ios::failbit | std::ios::badbit);
-
-        src_so.open(game_so_name, std::ios::binary);
-        dst_so.open(tmp_game, std::ios::binary);
-        dst_so << src_so.rdbuf();
-    }
-    catch (std::exception& ex)
-    {
-        std::clog << "can't copy dll: " << ex.what();
-        throw;
-    }
-
-    void* so_handle = SDL_LoadObject(tmp_game.c_str());
-    if (nullptr == so_handle)
-    {
-        std::string err_msg = SDL_GetError();
-        throw std::runtime_error("can't load: "s + tmp_game + " " + err_msg);
-    }
-
-    e.so_handle = so_handle;
 
-    std::string_view func_name = get_cxx_mangled_name();
-
-    void* func_address = SDL_LoadFunction(so_handle, func_name.data());
-
-    if (nullptr == func_address)
-    {
-        throw std::runtime_error(
-            "can't find "s +
-            "std::unique_ptr<om::game> create_game(om::engine&) "s +
-            "mangled name: "s + func_name.data() + " in so: " + tmp_game);
-    }
-
-    std::unique_ptr<om::game> (*func_ptr)(om::engine&);
-    func_ptr = reinterpret_cast<std::unique_ptr<om::game> (*)(om::engine&)>(
-        func_address);
-
-    std::unique_ptr<om::game> game = func_ptr(e);
-    return game;
+    const om::game_library library = om::load_game_library(
+        game_so_name, om::get_library_copy_path(game_so_name, 0));
+    e.so_handle = library.handle;
+    return library.create(e);
 }
 #endif
 
@@ -174,75 +118,206 @@ void start_game(om::engine_impl& e)
         return;
     }
 
-    namespace time    = std::chrono;
-    using clock_timer = time::high_resolution_clock;
-    using nano_sec    = time::nanoseconds;
-    using time_point  = time::time_point<clock_timer, nano_sec>;
-
-    time_point start = clock_timer::now();
+    namespace time = std::chrono;
 
     game->initialize();
 
-    auto process_events = [&game]()
+    auto process_events = [&game, &e](size_t frame)
     {
         om::event event;
+        if (e.replaying)
+        {
+            // devices are ignored, run has to be the same as recorded
+            while (e.input.next(frame, event))
+            {
+                game->process_input(event);
+            }
+            return;
+        }
         while (pool_event(event))
         {
+            if (!e.record_path.empty())
+            {
+                e.input.add(frame, event);
+            }
             game->process_input(event);
         }
     };
 
-    const fs::path     path       = get_game_library_path(e);
-    fs::file_time_type last_write = fs::last_write_time(path);
-
-    std::cout << std::format("{}", last_write) << std::endl;
+#if !defined(OM_STATIC)
+    // new build is found by inotify and loaded on background thread,
+    // headless run has nothing to reload and no thread is started
+    std::optional<om::library_reloader> reloader;
+    if (!e.headless)
+    {
+        reloader.emplace(get_game_library_path(e), e.frame_profiler);
+    }
+#endif
 
-    double timeout_reload_game  = 0.0; // seconds
-    bool   reload_timer_started = false;
+    om::frame_pacer& pacer = e.pacer;
+    pacer.restart(); // do not count time of initialize()
 
-    while (!game->is_closed())
+    const auto start = time::steady_clock::now();
+    size_t     frame = 0;
+    for (; !game->is_closed() && (e.max_frames == 0 || frame < e.max_frames);
+         ++frame)
     {
-        time_point end_last_frame = clock_timer::now();
-
-        auto frame_delta =
-            time::duration_cast<om::milliseconds>(end_last_frame - start);
+        // sleeps till next frame instead of spinning on full CPU core
+        pacer.wait_next_frame();
 
-        if (frame_delta.count() < 15) // 1000 % 60(FPS) = 16.666 ms
+        om::scoped_zone frame_zone(e.frame_profiler, e.frame_zone);
         {
-            std::this_thread::yield(); // too fast, give other apps CPU time
-            continue;                  // wait till more time
+            om::scoped_zone zone(e.frame_profiler, e.events_zone);
+            process_events(frame);
         }
-
-        process_events();
-
-        game->update(frame_delta);
-        game->draw();
-
-        fs::file_time_type last_time = fs::last_write_time(path);
-        if (last_time != last_write)
         {
-            reload_timer_started = true;
-            timeout_reload_game  = 2.0; // second
-            last_write           = last_time;
+            // decoded on workers, GPU upload has to be on main thread
+            om::scoped_zone zone(e.frame_profiler, e.upload_zone);
+            e.resources.update();
         }
-
-        if (reload_timer_started)
         {
-            timeout_reload_game -=
-                static_cast<double>(frame_delta.count()) * 0.001;
-            if (timeout_reload_game >= 0)
+            om::scoped_zone zone(e.frame_profiler, e.update_zone);
+            const auto      update_step =
+                time::duration_cast<om::milliseconds>(pacer.update_step());
+            int steps = 0;
+            for (; pacer.step(); ++steps)
             {
-                std::cout << "reloading library!" << std::endl;
+                game->update(update_step);
+            }
+            e.frame_profiler.counter(e.steps_count, steps);
+        }
+        {
+            om::scoped_zone zone(e.frame_profiler, e.draw_zone);
+            game->draw();
+        }
 
-                reload_timer_started = false;
+#if !defined(OM_STATIC)
+        // swap between frames, library is already loaded at this point
+        om::game_library library;
+        if (reloader && reloader->poll(library))
+        {
+            om::scoped_zone zone(e.frame_profiler, e.reload_zone);
+            std::cout << "reloading library!" << std::endl;
 
-                game.reset();
-                SDL_UnloadObject(e.so_handle);
+            game->serialize(e.arena);
+            game.reset();
+            e.resources.release_unused(); // types may live in library
+            SDL_UnloadObject(e.so_handle);
 
-                game = call_create_game(e);
+            e.so_handle = library.handle;
+            game        = library.create(e);
+            if (!game->restore(e.arena))
+            {
+                game->initialize();
             }
         }
+#endif
+    }
+
+    const om::pacing_report report = pacer.get_report();
+    std::clog << std::format("frames: {} late: {} target: {} mean error: {} "
+                             "max error: {}",
+                             report.frames,
+                             report.late_frames,
+                             report.target,
+                             report.mean_error,
+                             report.max_error)
+              << std::endl;
+
+    const time::duration<double> run_time = time::steady_clock::now() - start;
+    const double frames_per_second = static_cast<double>(frame) /
+                                     std::max(run_time.count(), 1e-9);
+    if (e.headless)
+    {
+        std::clog << std::format("headless: {} frames in {:.3f} s, {:.0f} "
+                                 "frames/s",
+                                 frame,
+                                 run_time.count(),
+                                 frames_per_second)
+                  << std::endl;
+    }
+
+    using ms = time::duration<double, std::milli>;
+    const std::vector<om::zone_stats> stats = e.get_frame_stats();
+    for (const om::zone_stats& zone : stats)
+    {
+        std::clog << std::format("{:>8}: p50 {:7.3f} p95 {:7.3f} p99 {:7.3f} "
+                                 "max {:7.3f} ms ({} frames)",
+                                 zone.name,
+                                 ms(zone.p50).count(),
+                                 ms(zone.p95).count(),
+                                 ms(zone.p99).count(),
+                                 ms(zone.max).count(),
+                                 zone.samples)
+                  << std::endl;
+    }
+
+    const std::vector<om::metric> metrics =
+        get_run_metrics(frame, frames_per_second, stats);
+    if (!e.report_path.empty())
+    {
+        write_report(e.report_path, metrics);
+    }
+    if (!e.baseline_path.empty())
+    {
+        const size_t regressions =
+            om::compare_metrics(metrics, e.baseline_path, e.tolerance);
+        if (regressions != 0)
+        {
+            throw std::runtime_error(
+                std::format("{} metrics are worse than in baseline: {}",
+                            regressions,
+                            e.baseline_path.string()));
+        }
+    }
+}
 
-        start = end_last_frame;
+std::vector<om::metric> get_run_metrics(
+    size_t                             frames,
+    double                             frames_per_second,
+    const std::vector<om::zone_stats>& stats)
+{
+    using ms = std::chrono::duration<double, std::milli>;
+
+    std::vector<om::metric> result;
+    result.push_back({ "run.frames", static_cast<double>(frames), "count" });
+    result.push_back({ "run.throughput", frames_per_second, "frames/s" });
+    for (const om::zone_stats& zone : stats)
+    {
+        std::string name = zone.name;
+        std::ranges::replace(name, ' ', '_');
+        result.push_back({ name + ".p50", ms(zone.p50).count(), "ms" });
+        result.push_back({ name + ".p99", ms(zone.p99).count(), "ms" });
+    }
+    return result;
+}
+
+// The same format as results of scanner_benchmark, om --baseline reads
+// it with om::compare_metrics()
+void write_report(const std::filesystem::path&   path,
+                  const std::vector<om::metric>& metrics)
+{
+    std::ofstream out(path);
+    bool          is_first = true;
+    auto add = [&](std::string_view name, double value, std::string_view unit)
+    {
+        out << (is_first ? "" : ",\n")
+            << std::format(R"(    {{"name": "{}", "value": {}, "unit": "{}"}})",
+                           name,
+                           value,
+                           unit);
+        is_first = false;
+    };
+
+    out << "{\n  \"metrics\": [\n";
+    for (const om::metric& m : metrics)
+    {
+        add(m.name, m.value, m.unit);
+    }
+    out << "\n  ]\n}\n";
+    if (!out)
+    {
+        std::cerr << "error: can't write report: " << path.string()
+                  << std::endl;
     }
 }
@@ -0,0 +1,61 @@
+#include "metrics.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+
+namespace om
+{
+
+size_t compare_metrics(const std::vector<metric>&   current,
+                       const std::filesystem::path& baseline,
+                       double                       tolerance)
+{
+    std::ifstream in(baseline);
+    if (!in)
+        throw std::runtime_error("can't read baseline: " + baseline.string());
+
+    const std::regex line(R"re("name": "([^"]+)", "value": ([^,]+),)re");
+    std::smatch      match;
+    std::string      text;
+    size_t           regressions = 0;
+    while (std::getline(in, text))
+    {
+        if (!std::regex_search(text, match, line))
+            continue;
+        auto it = std::ranges::find(current, match[1].str(), &metric::name);
+        if (it == current.end())
+        {
+            std::cout << "not measured: " << match[1].str() << '\n';
+            continue;
+        }
+        const double old = std::strtod(match[2].str().c_str(), nullptr);
+        if (it->unit == "count")
+        {
+            // other work was measured, its timings can't be compared
+            if (it->value != old)
+            {
+                std::cout << "changed: " << it->name << ' ' << old << " -> "
+                          << it->value << ' ' << it->unit << '\n';
+                ++regressions;
+            }
+            continue;
+        }
+        const bool per_second = it->unit.ends_with("/s");
+        const double limit =
+            old *
+            (per_second ? 1.0 - tolerance / 100.0 : 1.0 + tolerance / 100.0);
+        if (per_second ? it->value < limit : it->value > limit)
+        {
+            std::cout << "regression: " << it->name << ' ' << old << " -> "
+                      << it->value << ' ' << it->unit << '\n';
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+} // end namespace om
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace om
+{
+
+// One result of scanner_benchmark or of headless game run (--report)
+struct metric
+{
+    std::string name;
+    double      value = 0.0;
+    // ends with "/s" if bigger is better; "count" is size of work
+    // (files, matches, frames) and has to be the same in both runs
+    std::string unit;
+};
+
+// Reads results file, one metric per line:
+// {"name": "scan.time", "value": 12.5, "unit": "ms"}
+// Prints every metric worse than in baseline by more than tolerance
+// percent, every changed count and every baseline metric that is not
+// measured now, returns number of regressions and changed counts.
+// Throws std::runtime_error if file can't be read.
+size_t compare_metrics(const std::vector<metric>&   current,
+                       const std::filesystem::path& baseline,
+                       double                       tolerance);
+
+} // end namespace om
@@ -0,0 +1,325 @@
+#include "profiler.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace om
+{
+
+namespace
+{
+std::atomic<std::uint64_t> next_profiler_id{ 1 };
+
+// nearest rank of sorted samples
+std::chrono::nanoseconds get_percentile(const std::vector<std::int64_t>& sorted,
+                                        double                           part)
+{
+    const auto rank = static_cast<size_t>(
+        std::ceil(part * static_cast<double>(sorted.size())));
+    return std::chrono::nanoseconds(sorted[std::max<size_t>(rank, 1) - 1]);
+}
+
+void write_string(std::ostream& out, std::string_view text)
+{
+    out << '"';
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+} // namespace
+
+struct profiler::trace_event
+{
+    std::int64_t start; // nanoseconds since origin
+    std::int64_t value; // duration in nanoseconds or bits of counter
+    zone_id      zone;
+    char         phase; // 'X' complete zone, 'i' instant, 'C' counter
+};
+
+// Chunks are linked, not reallocated, so trace can be read while
+// threads still append to it
+struct profiler::trace_chunk
+{
+    static constexpr size_t capacity = 1024;
+
+    trace_event               events[capacity];
+    std::atomic<size_t>       count{ 0 };
+    std::atomic<trace_chunk*> next{ nullptr };
+};
+
+// Last window durations of one zone in nanoseconds
+struct profiler::zone_ring
+{
+    explicit zone_ring(size_t window)
+        : samples(new std::atomic<std::int64_t>[window]{})
+    {
+    }
+
+    std::unique_ptr<std::atomic<std::int64_t>[]> samples;
+    std::atomic<std::uint64_t>                   head{ 0 }; // samples written
+};
+
+struct profiler::thread_data
+{
+    ~thread_data()
+    {
+        for (std::atomic<zone_ring*>& ring : zones)
+            delete ring.load();
+        for (trace_chunk* chunk = first.load(); chunk != nullptr;)
+        {
+            trace_chunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    // ring is created by owner thread on first sample of zone
+    std::atomic<zone_ring*>   zones[max_zones]{};
+    std::atomic<trace_chunk*> first{ nullptr };
+    trace_chunk*               last{ nullptr }; // owner thread only
+    size_t                     events{ 0 };     // owner thread only
+    std::string                name;            // under profiler mutex
+};
+
+profiler::profiler(size_t window_)
+    : origin(clock::now())
+    , window(std::max<size_t>(window_, 1))
+    , id(next_profiler_id.fetch_add(1))
+{
+}
+
+profiler::~profiler() = default;
+
+zone_id profiler::add_zone(std::string_view name)
+{
+    std::lock_guard lock(mutex);
+    const auto      it = std::ranges::find(names, name);
+    if (it != names.end())
+        return static_cast<zone_id>(it - names.begin());
+    if (names.size() == max_zones)
+        throw std::length_error("too many profiler zones");
+    names.emplace_back(name);
+    return static_cast<zone_id>(names.size() - 1);
+}
+
+void profiler::record(zone_id           zone,
+                      clock::time_point start,
+                      clock::time_point end)
+{
+    using std::chrono::nanoseconds;
+
+    thread_data&       self     = get_thread();
+    const std::int64_t duration = std::max<std::int64_t>(
+        std::chrono::duration_cast<nanoseconds>(end - start).count(), 0);
+    zone_ring* ring = self.zones[zone].load(std::memory_order_relaxed);
+    if (ring == nullptr)
+    {
+        ring = new zone_ring(window);
+        self.zones[zone].store(ring, std::memory_order_release);
+    }
+    const std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->samples[head % window].store(duration, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+
+    if (tracing.load(std::memory_order_acquire))
+        add_event(trace_event{
+            std::chrono::duration_cast<nanoseconds>(start - origin).count(),
+            duration,
+            zone,
+            'X' });
+}
+
+std::vector<zone_stats> profiler::get_stats() const
+{
+    std::lock_guard                        lock(mutex);
+    std::vector<std::vector<std::int64_t>> durations(names.size());
+    for (const auto& thread : threads)
+    {
+        for (size_t zone = 0; zone < names.size(); ++zone)
+        {
+            const zone_ring* ring =
+                thread->zones[zone].load(std::memory_order_acquire);
+            if (ring == nullptr)
+                continue;
+            // newest samples first; slot being rewritten right now gives
+            // sample of the next frame, it is still a real sample
+            const std::uint64_t head =
+                ring->head.load(std::memory_order_acquire);
+            const std::uint64_t count = std::min<std::uint64_t>(head, window);
+            for (std::uint64_t i = 1;
+                 i <= count && durations[zone].size() < window;
+                 ++i)
+                durations[zone].push_back(
+                    ring->samples[(head - i) % window].load(
+                        std::memory_order_relaxed));
+        }
+    }
+
+    std::vector<zone_stats> result;
+    for (size_t zone = 0; zone < names.size(); ++zone)
+    {
+        std::vector<std::int64_t>& sorted = durations[zone];
+        if (sorted.empty())
+            continue;
+        std::ranges::sort(sorted);
+        zone_stats& stats = result.emplace_back();
+        stats.name        = names[zone];
+        stats.p50         = get_percentile(sorted, 0.50);
+        stats.p95         = get_percentile(sorted, 0.95);
+        stats.p99         = get_percentile(sorted, 0.99);
+        stats.max         = std::chrono::nanoseconds(sorted.back());
+        stats.samples     = sorted.size();
+    }
+    return result;
+}
+
+void profiler::enable_trace(size_t max_events_per_thread)
+{
+    max_events = max_events_per_thread;
+    tracing.store(true, std::memory_order_release);
+}
+
+bool profiler::is_tracing() const
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+void profiler::instant(zone_id zone)
+{
+    if (tracing.load(std::memory_order_acquire))
+        add_event(trace_event{
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - origin)
+                .count(),
+            0,
+            zone,
+            'i' });
+}
+
+void profiler::counter(zone_id zone, double value)
+{
+    if (tracing.load(std::memory_order_acquire))
+        add_event(trace_event{
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - origin)
+                .count(),
+            std::bit_cast<std::int64_t>(value),
+            zone,
+            'C' });
+}
+
+void profiler::set_thread_name(std::string_view name)
+{
+    thread_data&    self = get_thread();
+    std::lock_guard lock(mutex);
+    self.name = name;
+}
+
+void profiler::write_trace(const std::filesystem::path& path) const
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("can't write trace: " + path.string());
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::lock_guard lock(mutex);
+    bool            is_first = true;
+    auto            begin_event =
+        [&](std::string_view name, char phase, size_t tid)
+    {
+        out << (is_first ? "\n" : ",\n") << "{\"name\":";
+        is_first = false;
+        write_string(out, name);
+        out << ",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << tid;
+    };
+
+    for (size_t tid = 0; tid < threads.size(); ++tid)
+    {
+        const thread_data& thread = *threads[tid];
+        if (!thread.name.empty())
+        {
+            begin_event("thread_name", 'M', tid);
+            out << ",\"args\":{\"name\":";
+            write_string(out, thread.name);
+            out << "}}";
+        }
+        for (const trace_chunk* chunk =
+                 thread.first.load(std::memory_order_acquire);
+             chunk != nullptr;
+             chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            const size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const trace_event& event = chunk->events[i];
+                begin_event(names[event.zone], event.phase, tid);
+                out << ",\"ts\":" << static_cast<double>(event.start) * 0.001;
+                if (event.phase == 'X')
+                    out << ",\"dur\":"
+                        << static_cast<double>(event.value) * 0.001;
+                else if (event.phase == 'i')
+                    out << ",\"s\":\"t\"";
+                else
+                    out << ",\"args\":{\"value\":"
+                        << std::bit_cast<double>(event.value) << '}';
+                out << '}';
+            }
+        }
+    }
+    out << "\n]}\n";
+    if (!out)
+        throw std::runtime_error("can't write trace: " + path.string());
+}
+
+// Thread remembers data of the last profiler it wrote to, lock is taken
+// only on the first sample of a thread
+profiler::thread_data& profiler::get_thread()
+{
+    thread_local std::uint64_t owner  = 0;
+    thread_local thread_data*  cached = nullptr;
+    if (owner != id)
+    {
+        std::lock_guard lock(mutex);
+        cached = threads.emplace_back(std::make_unique<thread_data>()).get();
+        owner  = id;
+    }
+    return *cached;
+}
+
+void profiler::add_event(const trace_event& event)
+{
+    thread_data& self = get_thread();
+    if (self.events == max_events)
+        return;
+    ++self.events;
+
+    trace_chunk* chunk = self.last;
+    size_t       count = chunk ? chunk->count.load(std::memory_order_relaxed)
+                               : trace_chunk::capacity;
+    if (count == trace_chunk::capacity)
+    {
+        auto* next = new trace_chunk;
+        if (chunk == nullptr)
+            self.first.store(next, std::memory_order_release);
+        else
+            chunk->next.store(next, std::memory_order_release);
+        self.last = chunk = next;
+        count             = 0;
+    }
+    chunk->events[count] = event;
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+} // end namespace om
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "om/engine.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace om
+{
+
+using zone_id = std::uint8_t;
+
+// Zone durations of the last frames. Every thread writes to its own ring
+// of every zone without locks, so rare zone keeps its history while
+// frequent ones wrap. Mutex is taken only once per thread to create its
+// data and when stats are collected.
+// With trace enabled every zone, instant and counter is also kept in
+// append only per thread buffer and written as Chrome Trace Event JSON
+// (chrome://tracing, ui.perfetto.dev).
+class profiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr size_t max_zones = 256;
+
+    explicit profiler(size_t window = 300); // samples per zone in stats
+    ~profiler();
+    profiler(const profiler&)            = delete;
+    profiler& operator=(const profiler&) = delete;
+
+    // same name gives same id, call it on start, not every frame
+    zone_id add_zone(std::string_view name);
+    void record(zone_id zone, clock::time_point start, clock::time_point end);
+
+    // p50/p95/p99/max of the last window samples of every zone
+    [[nodiscard]] std::vector<zone_stats> get_stats() const;
+
+    // events after limit are dropped, 32 bytes each
+    void enable_trace(size_t max_events_per_thread = 1 << 20);
+    [[nodiscard]] bool is_tracing() const;
+    void               instant(zone_id zone); // no-op without trace
+    void               counter(zone_id zone, double value);
+    void               set_thread_name(std::string_view name);
+    // throws std::runtime_error if file can't be written
+    void write_trace(const std::filesystem::path& path) const;
+
+private:
+    struct zone_ring;
+    struct thread_data;
+    struct trace_event;
+    struct trace_chunk;
+
+    thread_data& get_thread();
+    void         add_event(const trace_event& event);
+
+    mutable std::mutex                        mutex;
+    std::vector<std::unique_ptr<thread_data>> threads; // outlive threads
+    std::vector<std::string>                  names;
+    clock::time_point                         origin; // trace time zero
+    size_t                                    window;
+    size_t                                    max_events{ 0 };
+    std::uint64_t                             id; // to find thread data
+    std::atomic<bool>                         tracing{ false };
+};
+
+// Records time from construction to destruction
+class scoped_zone
+{
+public:
+    scoped_zone(profiler& owner, zone_id zone)
+        : owner(owner)
+        , start(profiler::clock::now())
+        , zone(zone)
+    {
+    }
+    ~scoped_zone() { owner.record(zone, start, profiler::clock::now()); }
+    scoped_zone(const scoped_zone&)            = delete;
+    scoped_zone& operator=(const scoped_zone&) = delete;
+
+private:
+    profiler&                   owner;
+    profiler::clock::time_point start;
+    zone_id                     zone;
+};
+
+} // end namespace om
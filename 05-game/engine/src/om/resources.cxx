@@ -0,0 +1,385 @@
+#include "om/resources.hxx"
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace om
+{
+
+namespace
+{
+std::vector<std::byte> read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        throw std::runtime_error("can't open file: " + path);
+    std::vector<std::byte> result(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(result.data()),
+              static_cast<std::streamsize>(result.size()));
+    if (!file)
+        throw std::runtime_error("can't read file: " + path);
+    return result;
+}
+} // namespace
+
+resource_type::~resource_type() = default;
+
+void* bytes_type::decode(std::vector<std::byte>&& file) const
+{
+    return new std::vector<std::byte>(std::move(file));
+}
+
+size_t bytes_type::get_size(const void* data) const
+{
+    return static_cast<const std::vector<std::byte>*>(data)->size();
+}
+
+void bytes_type::destroy(void* data) const
+{
+    delete static_cast<std::vector<std::byte>*>(data);
+}
+
+struct resource_manager::impl
+{
+    struct entry
+    {
+        std::string                        path;
+        const resource_type*               type       = nullptr;
+        void*                              data       = nullptr;
+        size_t                             size       = 0;
+        std::uint32_t                      generation = 1;
+        std::uint32_t                      refs       = 0;
+        resource_state                     state = resource_state::empty;
+        std::list<std::uint32_t>::iterator lru; // valid while cached
+    };
+
+    // result of worker, data is not uploaded yet
+    struct decoded
+    {
+        std::uint32_t index = 0;
+        void*         data  = nullptr;
+        std::string   error;
+    };
+
+    impl(job_system& jobs_, size_t budget_)
+        : jobs(jobs_)
+        , budget(budget_)
+    {
+    }
+
+    [[nodiscard]] entry* find(handle h);
+    [[nodiscard]] handle get_handle(std::uint32_t index) const;
+    void                 start(std::uint32_t index);
+    void                 finish(decoded& result);
+    void                 take_decoded();
+    void                 remove(std::uint32_t index);
+    void                 evict();
+
+    job_system&                                    jobs;
+    job_counter                                    loads;
+    std::deque<entry>                              entries; // never move
+    std::vector<std::uint32_t>                     free_entries;
+    std::unordered_map<std::string, std::uint32_t> paths;
+    std::list<std::uint32_t> lru; // nobody uses them, least recent first
+    std::deque<decoded>      uploads;
+    std::mutex               mutex; // done is filled by workers
+    std::vector<decoded>     done;
+    size_t                   memory    = 0;
+    size_t                   budget    = 0;
+    size_t                   evictions = 0;
+};
+
+resource_manager::impl::entry* resource_manager::impl::find(handle h)
+{
+    const auto index = static_cast<size_t>(h >> 32);
+    if (index >= entries.size() ||
+        entries[index].generation != static_cast<std::uint32_t>(h))
+        return nullptr;
+    return &entries[index];
+}
+
+handle resource_manager::impl::get_handle(std::uint32_t index) const
+{
+    return handle{ index } << 32 | entries[index].generation;
+}
+
+void resource_manager::impl::start(std::uint32_t index)
+{
+    // worker reads only path and type, main thread does not change them
+    // while entry is loading
+    const entry* item = &entries[index];
+    jobs.run(loads,
+             [this, item, index]
+             {
+                 decoded result;
+                 result.index = index;
+                 try
+                 {
+                     result.data = item->type->decode(read_file(item->path));
+                 }
+                 catch (std::exception& ex)
+                 {
+                     result.error = ex.what();
+                 }
+                 std::lock_guard lock(mutex);
+                 done.push_back(std::move(result));
+             });
+}
+
+void resource_manager::impl::finish(decoded& result)
+{
+    entry& item = entries[result.index];
+    if (!result.error.empty())
+    {
+        std::clog << "can't load resource: " << result.error << std::endl;
+        item.state = resource_state::failed;
+        if (item.refs == 0)
+            remove(result.index);
+        return;
+    }
+
+    item.type->upload(result.data);
+    item.data  = result.data;
+    item.size  = item.type->get_size(item.data);
+    item.state = resource_state::ready;
+    memory += item.size;
+    if (item.refs == 0)
+        item.lru = lru.insert(lru.end(), result.index);
+    evict();
+}
+
+void resource_manager::impl::take_decoded()
+{
+    std::lock_guard lock(mutex);
+    for (decoded& result : done)
+        uploads.push_back(std::move(result));
+    done.clear();
+}
+
+void resource_manager::impl::remove(std::uint32_t index)
+{
+    entry& item = entries[index];
+    if (item.state == resource_state::ready)
+    {
+        if (item.refs == 0)
+            lru.erase(item.lru);
+        memory -= item.size;
+        item.type->destroy(item.data);
+    }
+    paths.erase(item.path);
+    const std::uint32_t generation = item.generation + 1;
+    item            = entry{};
+    item.generation = generation == 0 ? 1 : generation; // 0 is no handle
+    free_entries.push_back(index);
+}
+
+void resource_manager::impl::evict()
+{
+    while (memory > budget && !lru.empty())
+    {
+        remove(lru.front());
+        ++evictions;
+    }
+}
+
+resource_manager::resource_manager(job_system& jobs, size_t memory_budget)
+    : pImpl(new impl(jobs, memory_budget))
+{
+}
+
+resource_manager::~resource_manager()
+{
+    pImpl->jobs.wait(pImpl->loads);
+    pImpl->take_decoded();
+    for (impl::decoded& result : pImpl->uploads)
+    {
+        if (result.data != nullptr)
+            pImpl->entries[result.index].type->destroy(result.data);
+    }
+    for (impl::entry& item : pImpl->entries)
+    {
+        if (item.state == resource_state::ready)
+            item.type->destroy(item.data);
+    }
+    delete pImpl;
+}
+
+resource resource_manager::load(std::string_view     path,
+                               const resource_type& type)
+{
+    auto [it, is_new] = pImpl->paths.try_emplace(std::string(path), 0);
+    if (!is_new)
+    {
+        if (pImpl->entries[it->second].type != &type)
+            throw std::invalid_argument(
+                "resource is loaded with other type: " + it->first);
+        return resource(this, pImpl->get_handle(it->second));
+    }
+
+    std::uint32_t index = 0;
+    if (pImpl->free_entries.empty())
+    {
+        index = static_cast<std::uint32_t>(pImpl->entries.size());
+        pImpl->entries.emplace_back();
+    }
+    else
+    {
+        index = pImpl->free_entries.back();
+        pImpl->free_entries.pop_back();
+    }
+    it->second        = index;
+    impl::entry& item = pImpl->entries[index];
+    item.path         = it->first;
+    item.type         = &type;
+    item.state        = resource_state::loading;
+    resource result(this, pImpl->get_handle(index));
+    pImpl->start(index);
+    return result;
+}
+
+size_t resource_manager::update(size_t max_uploads)
+{
+    pImpl->take_decoded();
+    size_t count = 0;
+    for (; count < max_uploads && !pImpl->uploads.empty(); ++count)
+    {
+        pImpl->finish(pImpl->uploads.front());
+        pImpl->uploads.pop_front();
+    }
+    return count;
+}
+
+void resource_manager::set_memory_budget(size_t bytes)
+{
+    pImpl->budget = bytes;
+    pImpl->evict();
+}
+
+void resource_manager::release_unused()
+{
+    pImpl->jobs.wait(pImpl->loads);
+    pImpl->take_decoded();
+    update(pImpl->uploads.size());
+    while (!pImpl->lru.empty())
+        pImpl->remove(pImpl->lru.front());
+}
+
+resource_stats resource_manager::get_stats() const
+{
+    resource_stats stats;
+    for (const impl::entry& item : pImpl->entries)
+    {
+        stats.loading += item.state == resource_state::loading;
+        stats.ready += item.state == resource_state::ready;
+        stats.failed += item.state == resource_state::failed;
+    }
+    stats.cached    = pImpl->lru.size();
+    stats.memory    = pImpl->memory;
+    stats.budget    = pImpl->budget;
+    stats.evictions = pImpl->evictions;
+    return stats;
+}
+
+void resource_manager::add_ref(handle h)
+{
+    impl::entry* item = pImpl->find(h);
+    if (item->refs++ == 0 && item->state == resource_state::ready)
+        pImpl->lru.erase(item->lru);
+}
+
+void resource_manager::release(handle h)
+{
+    impl::entry* item = pImpl->find(h);
+    if (--item->refs != 0)
+        return;
+    const auto index = static_cast<std::uint32_t>(h >> 32);
+    if (item->state == resource_state::ready)
+    {
+        item->lru = pImpl->lru.insert(pImpl->lru.end(), index);
+        pImpl->evict();
+    }
+    else if (item->state == resource_state::failed)
+        pImpl->remove(index); // next load tries again
+}
+
+resource_state resource_manager::get_state(handle h) const
+{
+    const impl::entry* item = pImpl->find(h);
+    return item ? item->state : resource_state::empty;
+}
+
+std::string_view resource_manager::get_path(handle h) const
+{
+    const impl::entry* item = pImpl->find(h);
+    return item ? std::string_view(item->path) : std::string_view();
+}
+
+void* resource_manager::get_data(handle h) const
+{
+    const impl::entry* item = pImpl->find(h);
+    return item ? item->data : nullptr;
+}
+
+resource::resource(resource_manager* owner_, handle h_)
+    : owner(owner_)
+    , h(h_)
+{
+    owner->add_ref(h);
+}
+
+resource::resource(const resource& other)
+    : owner(other.owner)
+    , h(other.h)
+{
+    if (owner != nullptr)
+        owner->add_ref(h);
+}
+
+resource::resource(resource&& other) noexcept
+    : owner(std::exchange(other.owner, nullptr))
+    , h(std::exchange(other.h, 0))
+{
+}
+
+resource& resource::operator=(resource other) noexcept
+{
+    std::swap(owner, other.owner);
+    std::swap(h, other.h);
+    return *this;
+}
+
+resource::~resource()
+{
+    if (owner != nullptr)
+        owner->release(h);
+}
+
+resource_state resource::get_state() const
+{
+    return owner ? owner->get_state(h) : resource_state::empty;
+}
+
+bool resource::is_ready() const
+{
+    return get_state() == resource_state::ready;
+}
+
+std::string_view resource::get_path() const
+{
+    return owner ? owner->get_path(h) : std::string_view();
+}
+
+void* resource::get_data() const
+{
+    return owner ? owner->get_data(h) : nullptr;
+}
+
+} // end namespace om
@@ -0,0 +1,110 @@
+#include "om/engine.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace om
+{
+
+// Blocks are cut from big chunks and never move, so state pointers taken
+// by game stay valid over any number of reloads
+struct state_arena::impl
+{
+    struct block
+    {
+        std::string name;
+        void*       data      = nullptr;
+        size_t      size      = 0;
+        size_t      alignment = 0;
+    };
+
+    static constexpr size_t chunk_size = 64 * 1024;
+
+    void* allocate(size_t size, size_t alignment);
+
+    std::vector<std::unique_ptr<std::byte[]>> chunks; // kept after clear()
+    std::vector<std::unique_ptr<std::byte[]>> large;  // one block each
+    std::vector<block>                        blocks;
+    size_t                                    used  = 0; // chunks
+    void*                                     top   = nullptr;
+    size_t                                    space = 0;
+};
+
+void* state_arena::impl::allocate(size_t size, size_t alignment)
+{
+    const size_t need = size + alignment - 1;
+    if (need > chunk_size)
+    {
+        large.emplace_back(new std::byte[need]);
+        void*  data        = large.back().get();
+        size_t large_space = need;
+        return std::align(alignment, size, data, large_space);
+    }
+    void* data = std::align(alignment, size, top, space);
+    if (data == nullptr)
+    {
+        if (used == chunks.size())
+            chunks.emplace_back(new std::byte[chunk_size]);
+        top   = chunks[used++].get();
+        space = chunk_size;
+        data  = std::align(alignment, size, top, space);
+    }
+    top = static_cast<std::byte*>(data) + size;
+    space -= size;
+    return data;
+}
+
+state_arena::state_arena()
+    : pImpl(new impl)
+{
+}
+
+state_arena::~state_arena()
+{
+    delete pImpl;
+}
+
+void* state_arena::get(std::string_view name, size_t size, size_t alignment)
+{
+    if (!std::has_single_bit(alignment))
+        throw std::invalid_argument("alignment has to be power of two");
+    if (void* data = find(name, size, alignment))
+        return data;
+
+    void* data = pImpl->allocate(size, alignment);
+    std::memset(data, 0, size);
+
+    auto it = std::ranges::find(pImpl->blocks, name, &impl::block::name);
+    if (it == pImpl->blocks.end())
+        it = pImpl->blocks.insert(it, impl::block{ std::string(name) });
+    it->data      = data;
+    it->size      = size;
+    it->alignment = alignment;
+    return data;
+}
+
+void* state_arena::find(std::string_view name,
+                        size_t           size,
+                        size_t           alignment) const
+{
+    const auto it = std::ranges::find(pImpl->blocks, name, &impl::block::name);
+    if (it == pImpl->blocks.end() || it->size != size ||
+        it->alignment != alignment)
+        return nullptr;
+    return it->data;
+}
+
+void state_arena::clear()
+{
+    pImpl->blocks.clear();
+    pImpl->large.clear();
+    pImpl->used  = 0;
+    pImpl->top   = nullptr;
+    pImpl->space = 0;
+}
+
+} // end namespace om
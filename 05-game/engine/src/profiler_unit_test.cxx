@@ -0,0 +1,139 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/profiler.hxx"
+
+namespace
+{
+using std::chrono::nanoseconds;
+
+// records durations first, first + 1, ... last nanoseconds
+void record_range(om::profiler& p, om::zone_id zone, int first, int last)
+{
+    const auto start = om::profiler::clock::now();
+    for (int i = first; i <= last; ++i)
+        p.record(zone, start, start + nanoseconds(i));
+}
+
+const om::zone_stats* find_stats(const std::vector<om::zone_stats>& stats,
+                                 std::string_view                   name)
+{
+    for (const om::zone_stats& s : stats)
+        if (s.name == name)
+            return &s;
+    return nullptr;
+}
+} // namespace
+
+TEST_CASE("profiler test")
+{
+    SECTION("zones")
+    {
+        om::profiler p;
+        const om::zone_id update = p.add_zone("update");
+        const om::zone_id render = p.add_zone("render");
+        REQUIRE(update != render);
+        REQUIRE(p.add_zone("update") == update);
+        REQUIRE(p.get_stats().empty());
+    }
+    SECTION("percentiles from two threads")
+    {
+        om::profiler      p;
+        const om::zone_id zone = p.add_zone("frame");
+        std::thread       first([&] { record_range(p, zone, 1, 100); });
+        std::thread       second([&] { record_range(p, zone, 101, 200); });
+        first.join();
+        second.join();
+
+        const auto stats = p.get_stats();
+        REQUIRE(stats.size() == 1);
+        REQUIRE(stats[0].name == "frame");
+        REQUIRE(stats[0].samples == 200);
+        REQUIRE(stats[0].p50 == nanoseconds(100));
+        REQUIRE(stats[0].p95 == nanoseconds(190));
+        REQUIRE(stats[0].p99 == nanoseconds(198));
+        REQUIRE(stats[0].max == nanoseconds(200));
+    }
+    SECTION("window wrap")
+    {
+        om::profiler      p(10);
+        const om::zone_id zone = p.add_zone("frame");
+        record_range(p, zone, 1, 25);
+
+        const auto stats = p.get_stats();
+        REQUIRE(stats.size() == 1);
+        REQUIRE(stats[0].samples == 10); // only 16..25 are left
+        REQUIRE(stats[0].p50 == nanoseconds(20));
+        REQUIRE(stats[0].max == nanoseconds(25));
+    }
+    SECTION("rare zone survives frequent ones")
+    {
+        om::profiler      p(10);
+        const om::zone_id rare     = p.add_zone("load");
+        const om::zone_id frequent = p.add_zone("frame");
+        record_range(p, rare, 1000, 1000);
+        record_range(p, frequent, 1, 100);
+
+        const auto            stats = p.get_stats();
+        const om::zone_stats* load  = find_stats(stats, "load");
+        const om::zone_stats* frame = find_stats(stats, "frame");
+        REQUIRE(load != nullptr);
+        REQUIRE(frame != nullptr);
+        REQUIRE(load->samples == 1);
+        REQUIRE(load->max == nanoseconds(1000));
+        REQUIRE(frame->samples == 10);
+        REQUIRE(frame->max == nanoseconds(100));
+    }
+    SECTION("write trace")
+    {
+        om::profiler      p;
+        const om::zone_id zone  = p.add_zone("frame");
+        const om::zone_id mark  = p.add_zone("reload");
+        const om::zone_id value = p.add_zone("fps");
+        p.instant(mark); // trace is not enabled yet
+        REQUIRE(!p.is_tracing());
+
+        p.enable_trace(4);
+        REQUIRE(p.is_tracing());
+        p.set_thread_name("main \"thread\"");
+        record_range(p, zone, 5000, 5000);
+        p.instant(mark);
+        p.counter(value, 60.0);
+        record_range(p, zone, 1, 3); // only first fits in limit of 4
+
+        const std::filesystem::path path =
+            std::filesystem::temp_directory_path() / "om_profiler_test.json";
+        p.write_trace(path);
+        std::stringstream text;
+        text << std::ifstream(path).rdbuf();
+        std::filesystem::remove(path);
+        const std::string trace = text.str();
+
+        auto count = [&trace](std::string_view part)
+        {
+            size_t result = 0;
+            for (size_t pos = trace.find(part); pos != std::string::npos;
+                 pos        = trace.find(part, pos + 1))
+                ++result;
+            return result;
+        };
+        REQUIRE(trace.starts_with("{\"displayTimeUnit\":\"ms\","
+                                  "\"traceEvents\":["));
+        REQUIRE(trace.ends_with("\n]}\n"));
+        REQUIRE(count("\"name\":\"thread_name\",\"ph\":\"M\"") == 1);
+        REQUIRE(count("\"args\":{\"name\":\"main \\\"thread\\\"\"}") == 1);
+        REQUIRE(count("\"name\":\"frame\",\"ph\":\"X\"") == 2);
+        REQUIRE(count("\"dur\":5.000") == 1);
+        REQUIRE(count("\"dur\":0.001") == 1);
+        REQUIRE(count("\"name\":\"reload\",\"ph\":\"i\"") == 1);
+        REQUIRE(count("\"name\":\"fps\",\"ph\":\"C\"") == 1);
+        REQUIRE(count("\"args\":{\"value\":60.000}") == 1);
+    }
+}
@@ -0,0 +1,177 @@
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/resources.hxx"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// counts bytes as text, checks that upload is done on main thread
+class text_type final : public om::resource_type
+{
+public:
+    void* decode(std::vector<std::byte>&& file) const override
+    {
+        if (file.empty())
+            throw std::runtime_error("empty text");
+        return new std::string(reinterpret_cast<const char*>(file.data()),
+                               file.size());
+    }
+    void upload(void*) const override
+    {
+        if (std::this_thread::get_id() == main_thread)
+            ++uploads;
+    }
+    size_t get_size(const void* data) const override
+    {
+        return static_cast<const std::string*>(data)->size();
+    }
+    void destroy(void* data) const override
+    {
+        ++destroyed;
+        delete static_cast<std::string*>(data);
+    }
+
+    std::thread::id main_thread = std::this_thread::get_id();
+    mutable size_t  uploads     = 0;
+    mutable size_t  destroyed   = 0;
+};
+
+void wait_loaded(om::resource_manager& manager, const om::resource& item)
+{
+    while (item.get_state() == om::resource_state::loading)
+    {
+        manager.update();
+        std::this_thread::yield();
+    }
+}
+} // namespace
+
+TEST_CASE("resource manager test")
+{
+    fs::create_directories("test-resources");
+    for (char name : std::string("abcd"))
+    {
+        std::ofstream file(std::string("test-resources/") + name + ".txt");
+        file << std::string(100, name);
+    }
+    std::ofstream("test-resources/empty.txt").close();
+
+    text_type            text;
+    om::job_system       jobs(2);
+    om::resource_manager manager(jobs, 250);
+
+    SECTION("load once")
+    {
+        om::resource a = manager.load("test-resources/a.txt", text);
+        REQUIRE(a.get_handle() != 0);
+        REQUIRE(a.get_path() == "test-resources/a.txt");
+        om::resource same = manager.load("test-resources/a.txt", text);
+        REQUIRE(a == same);
+        wait_loaded(manager, a);
+        REQUIRE(a.is_ready());
+        REQUIRE(*a.get<std::string>() == std::string(100, 'a'));
+        REQUIRE(text.uploads == 1);
+
+        om::resource copy = a;
+        REQUIRE(copy.get_data() == a.get_data());
+        REQUIRE(manager.get_stats().ready == 1);
+        REQUIRE(manager.get_stats().memory == 100);
+        REQUIRE(manager.get_stats().cached == 0);
+
+        const om::bytes_type bytes;
+        REQUIRE_THROWS_AS(manager.load("test-resources/a.txt", bytes),
+                          std::invalid_argument);
+    }
+    SECTION("lru eviction")
+    {
+        {
+            om::resource a = manager.load("test-resources/a.txt", text);
+            om::resource b = manager.load("test-resources/b.txt", text);
+            wait_loaded(manager, a);
+            wait_loaded(manager, b);
+        }
+        // nobody uses them, but they fit into budget
+        REQUIRE(manager.get_stats().cached == 2);
+        REQUIRE(manager.get_stats().memory == 200);
+
+        om::resource a = manager.load("test-resources/a.txt", text);
+        REQUIRE(a.is_ready()); // from cache, not loaded again
+        REQUIRE(manager.get_stats().cached == 1);
+
+        // c does not fit, least recently used b is evicted, a is used
+        om::resource c = manager.load("test-resources/c.txt", text);
+        wait_loaded(manager, c);
+        REQUIRE(c.is_ready());
+        REQUIRE(a.is_ready());
+        const om::resource_stats stats = manager.get_stats();
+        REQUIRE(stats.evictions == 1);
+        REQUIRE(stats.memory == 200);
+        REQUIRE(stats.cached == 0);
+        REQUIRE(text.destroyed == 1);
+        REQUIRE(text.uploads == 3);
+
+        // used resources stay over budget
+        manager.set_memory_budget(0);
+        REQUIRE(manager.get_stats().memory == 200);
+        c = om::resource();
+        REQUIRE(manager.get_stats().memory == 100);
+        REQUIRE(manager.get_stats().evictions == 2);
+    }
+    SECTION("failed load")
+    {
+        om::resource missing = manager.load("test-resources/none.txt", text);
+        om::resource empty   = manager.load("test-resources/empty.txt", text);
+        wait_loaded(manager, missing);
+        wait_loaded(manager, empty);
+        REQUIRE(missing.get_state() == om::resource_state::failed);
+        REQUIRE(empty.get_state() == om::resource_state::failed);
+        REQUIRE(empty.get_data() == nullptr);
+        REQUIRE(manager.get_stats().failed == 2);
+
+        // failed resource is forgotten when released, next load retries
+        empty = om::resource();
+        REQUIRE(manager.get_stats().failed == 1);
+        std::ofstream("test-resources/empty.txt") << "not empty";
+        empty = manager.load("test-resources/empty.txt", text);
+        wait_loaded(manager, empty);
+        REQUIRE(*empty.get<std::string>() == "not empty");
+    }
+    SECTION("upload limit")
+    {
+        std::vector<om::resource> all;
+        for (char name : std::string("abcd"))
+            all.push_back(manager.load(
+                std::string("test-resources/") + name + ".txt", text));
+        manager.set_memory_budget(1000);
+        size_t uploaded = 0;
+        while (uploaded < all.size())
+        {
+            const size_t count = manager.update(1);
+            REQUIRE(count <= 1);
+            uploaded += count;
+        }
+        REQUIRE(manager.get_stats().ready == 4);
+        REQUIRE(manager.get_stats().loading == 0);
+
+        all.clear();
+        REQUIRE(manager.get_stats().cached == 4);
+        manager.release_unused();
+        REQUIRE(manager.get_stats().ready == 0);
+        REQUIRE(manager.get_stats().memory == 0);
+        REQUIRE(text.destroyed == 4);
+    }
+    SECTION("loading on destruction")
+    {
+        om::resource a = manager.load("test-resources/a.txt", text);
+        a              = om::resource();
+        // manager destructor waits for decode and frees result
+    }
+}
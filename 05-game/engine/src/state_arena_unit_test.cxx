@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include "om/engine.hxx"
+
+namespace
+{
+struct player
+{
+    float         x     = 1.0f;
+    float         y     = 2.0f;
+    std::uint32_t score = 0;
+};
+} // namespace
+
+TEST_CASE("state arena test")
+{
+    om::state_arena arena;
+
+    SECTION("named blocks")
+    {
+        player& first = arena.get<player>("player");
+        REQUIRE(first.x == 1.0f); // value initialized
+        first.score = 42;
+
+        REQUIRE(&arena.get<player>("player") == &first);
+        REQUIRE(arena.find<player>("player") == &first);
+        REQUIRE(arena.find<player>("enemy") == nullptr);
+        REQUIRE(arena.find<double>("player") == nullptr); // other size
+
+        player& enemy = arena.get<player>("enemy");
+        REQUIRE(&enemy != &first);
+        REQUIRE(first.score == 42);
+
+        void* raw = arena.get("raw", 16, 16);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(raw) % 16 == 0);
+        REQUIRE_THROWS_AS(arena.get("bad", 16, 3), std::invalid_argument);
+    }
+    SECTION("chunk overflow and large blocks")
+    {
+        // blocks of one chunk, next one, and bigger than chunk
+        auto* a = static_cast<std::byte*>(arena.get("a", 40 * 1024, 8));
+        auto* b = static_cast<std::byte*>(arena.get("b", 40 * 1024, 8));
+        auto* c = static_cast<std::byte*>(arena.get("c", 200 * 1024, 64));
+        REQUIRE((b >= a + 40 * 1024 || b + 40 * 1024 <= a));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(c) % 64 == 0);
+        std::memset(a, 1, 40 * 1024);
+        std::memset(b, 2, 40 * 1024);
+        std::memset(c, 3, 200 * 1024);
+
+        // blocks never move and keep data
+        REQUIRE(arena.find("a", 40 * 1024, 8) == a);
+        REQUIRE(arena.find("c", 200 * 1024, 64) == c);
+        REQUIRE(a[40 * 1024 - 1] == std::byte{ 1 });
+        REQUIRE(b[0] == std::byte{ 2 });
+        REQUIRE(c[200 * 1024 - 1] == std::byte{ 3 });
+    }
+    SECTION("size change drops old block")
+    {
+        auto* old_block = static_cast<std::byte*>(arena.get("state", 32, 8));
+        std::memset(old_block, 7, 32);
+
+        // layout changed: new zeroed block, old one can't be found
+        auto* new_block = static_cast<std::byte*>(arena.get("state", 48, 8));
+        REQUIRE(new_block != old_block);
+        REQUIRE(new_block[0] == std::byte{ 0 });
+        REQUIRE(new_block[47] == std::byte{ 0 });
+        REQUIRE(arena.find("state", 32, 8) == nullptr);
+        REQUIRE(arena.find("state", 48, 8) == new_block);
+
+        // alignment is part of layout too
+        REQUIRE(arena.find("state", 48, 16) == nullptr);
+        auto* aligned = arena.get("state", 48, 16);
+        REQUIRE(aligned != new_block);
+        REQUIRE(arena.find("state", 48, 8) == nullptr);
+    }
+    SECTION("clear")
+    {
+        arena.get<player>("player").score = 7;
+        REQUIRE(arena.get("large", 100 * 1024, 8) != nullptr);
+        arena.clear();
+        REQUIRE(arena.find<player>("player") == nullptr);
+        REQUIRE(arena.find("large", 100 * 1024, 8) == nullptr);
+        REQUIRE(arena.get<player>("player").score == 0);
+    }
+}
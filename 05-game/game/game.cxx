@@ -14,13 +14,22 @@ public:
     void               update(om::milliseconds frame_delta) override;
     void               draw() const override;
     [[nodiscard]] bool is_closed() const override;
+    [[nodiscard]] bool restore(om::state_arena& arena) override;
 
 private:
+    // lives in engine arena, new library instance after reload goes on
+    // with the same memory, nothing is copied on serialize()
+    struct state
+    {
+        size_t index = 0;
+        double fps   = 1.0 / 12;
+    };
+
     om::engine&         e;
     std::array<char, 5> anim;
-    size_t              index    = 0;
     const double        fps_base = 1.0 / 12;
-    double              fps      = 1.0 / 12;
+    bool                is_restored; // state was in arena before
+    state&              s;
 };
 
 std::unique_ptr<om::game> OM_GAME create_game(om::engine& e)
@@ -31,6 +40,8 @@ std::unique_ptr<om::game> OM_GAME create_game(om::engine& e)
 tic_tac_toe::tic_tac_toe(om::engine& e_)
     : e(e_)
     , anim({ { '-', '\\', '|', '/', '-' } })
+    , is_restored(e_.get_state_arena().find<state>("tic_tac_toe") != nullptr)
+    , s(e_.get_state_arena().get<state>("tic_tac_toe"))
 {
     om::engine::params params;
 
@@ -41,7 +52,10 @@ tic_tac_toe::tic_tac_toe(om::engine& e_)
     e.initialize(params);
 }
 
-void tic_tac_toe::initialize() {}
+void tic_tac_toe::initialize()
+{
+    s = state{};
+}
 
 void tic_tac_toe::process_input(om::event&) {}
 
@@ -49,8 +63,8 @@ void tic_tac_toe::update(om::milliseconds frame_delta)
 {
     const double dt =
         static_cast<double>(frame_delta.count()) * 0.001; // seconds
-    fps -= dt;
-    if (fps <= 0)
+    s.fps -= dt;
+    if (s.fps <= 0)
     {
         constexpr int count_lines = 4;
         int back_chars  = count_lines;
@@ -62,11 +76,11 @@ void tic_tac_toe::update(om::milliseconds frame_delta)
         int lines = count_lines;
         while (lines--)
         {
-            index = (index + 1) % anim.size();
-            std::cout << anim[index] << std::flush;
+            s.index = (s.index + 1) % anim.size();
+            std::cout << anim[s.index] << std::flush;
         }
 
-        fps += fps_base;
+        s.fps += fps_base;
     }
 }
 
@@ -76,3 +90,8 @@ bool tic_tac_toe::is_closed() const
 {
     return false;
 }
+
+bool tic_tac_toe::restore(om::state_arena&)
+{
+    return is_restored;
+}